@@ -0,0 +1,120 @@
+#include "ast_copy.h"
+
+// =================== Expressions ===================
+
+ExpressionNode* copyExpression(const ExpressionNode* expr, const Substitution& subst) {
+    if (!expr) return nullptr;
+    if (auto* var = dynamic_cast<const VarNode*>(expr)) {
+        auto it = subst.find(var->name);
+        if (it != subst.end()) return new NumberNode(it->second);
+        return new VarNode(var->name);
+    }
+    if (auto* number = dynamic_cast<const NumberNode*>(expr)) return new NumberNode(number->value);
+    if (auto* str = dynamic_cast<const StringNode*>(expr)) return new StringNode(str->value);
+    if (auto* boolean = dynamic_cast<const BoolNode*>(expr)) return new BoolNode(boolean->value);
+    if (auto* unary = dynamic_cast<const UnaryOpNode*>(expr)) {
+        return new UnaryOpNode(unary->op, copyExpression(unary->operand, subst));
+    }
+    if (auto* binary = dynamic_cast<const BinaryOpNode*>(expr)) {
+        return new BinaryOpNode(copyExpression(binary->left, subst), binary->op, copyExpression(binary->right, subst));
+    }
+    if (auto* call = dynamic_cast<const FuncCallNode*>(expr)) {
+        AstNodeList<ExpressionNode>* args = nullptr;
+        if (call->args) {
+            args = new AstNodeList<ExpressionNode>();
+            for (auto* arg : call->args->elements) args->elements.push_back(copyExpression(arg, subst));
+        }
+        return new FuncCallNode(call->name, args);
+    }
+    return nullptr; // Every expression node is handled above
+}
+
+// =================== Statements ===================
+
+static StatementNode* copyStatement(const StatementNode* stmt, const Substitution& subst) {
+    if (dynamic_cast<const HaltNode*>(stmt)) return new HaltNode();
+    if (auto* print = dynamic_cast<const PrintNode*>(stmt)) {
+        return new PrintNode(copyExpression(print->expression, subst));
+    }
+    if (auto* call = dynamic_cast<const ProcCallNode*>(stmt)) {
+        AstNodeList<ExpressionNode>* args = nullptr;
+        if (call->args) {
+            args = new AstNodeList<ExpressionNode>();
+            for (auto* arg : call->args->elements) args->elements.push_back(copyExpression(arg, subst));
+        }
+        return new ProcCallNode(call->name, args);
+    }
+    if (auto* assign = dynamic_cast<const AssignNode*>(stmt)) {
+        // Assigned parameters are never substituted, so the target stays a variable
+        return new AssignNode(new VarNode(assign->var->name), copyExpression(assign->expression, subst));
+    }
+    if (auto* ifNode = dynamic_cast<const IfNode*>(stmt)) {
+        return new IfNode(copyExpression(ifNode->condition, subst), copyStatements(ifNode->then_branch, subst));
+    }
+    if (auto* ifElse = dynamic_cast<const IfElseNode*>(stmt)) {
+        return new IfElseNode(copyExpression(ifElse->condition, subst), copyStatements(ifElse->then_branch, subst),
+                              copyStatements(ifElse->else_branch, subst));
+    }
+    if (auto* whileNode = dynamic_cast<const WhileNode*>(stmt)) {
+        return new WhileNode(copyExpression(whileNode->condition, subst), copyStatements(whileNode->body, subst));
+    }
+    if (auto* doUntil = dynamic_cast<const DoUntilNode*>(stmt)) {
+        return new DoUntilNode(copyStatements(doUntil->body, subst), copyExpression(doUntil->condition, subst));
+    }
+    if (auto* ret = dynamic_cast<const ReturnNode*>(stmt)) {
+        return new ReturnNode(copyExpression(ret->expression, subst));
+    }
+    return nullptr; // Every statement node is handled above
+}
+
+AstNodeList<StatementNode>* copyStatements(const AstNodeList<StatementNode>* stmts, const Substitution& subst) {
+    if (!stmts) return nullptr;
+    auto* copy = new AstNodeList<StatementNode>();
+    for (auto* stmt : stmts->elements) copy->elements.push_back(copyStatement(stmt, subst));
+    return copy;
+}
+
+// =================== Definitions ===================
+
+AstNodeList<VarNode>* copyVariables(const AstNodeList<VarNode>* vars) {
+    if (!vars) return nullptr;
+    auto* copy = new AstNodeList<VarNode>();
+    for (auto* var : vars->elements) copy->elements.push_back(new VarNode(var->name));
+    return copy;
+}
+
+static BodyNode* copyBody(const BodyNode* body) {
+    if (!body) return nullptr;
+    return new BodyNode(copyVariables(body->locals), copyStatements(body->statements));
+}
+
+AstNode* copyDefinition(const AstNode* node) {
+    if (auto* globals = dynamic_cast<const AstNodeList<VarNode>*>(node)) return copyVariables(globals);
+    if (auto* proc = dynamic_cast<const ProcDefNode*>(node)) {
+        return new ProcDefNode(proc->name, copyVariables(proc->params), copyBody(proc->body));
+    }
+    if (auto* func = dynamic_cast<const FuncDefNode*>(node)) {
+        return new FuncDefNode(func->name, copyVariables(func->params), copyBody(func->body));
+    }
+    if (auto* main = dynamic_cast<const MainProgNode*>(node)) {
+        return new MainProgNode(copyVariables(main->locals), copyStatements(main->statements));
+    }
+    return nullptr;
+}
+
+ProgramNode* copyProgram(const ProgramNode* program) {
+    auto* copy = new ProgramNode(copyVariables(program->globals), new AstNodeList<ProcDefNode>(),
+                                 new AstNodeList<FuncDefNode>(), nullptr);
+    if (program->procs) {
+        for (auto* proc : program->procs->elements) {
+            copy->procs->elements.push_back(static_cast<ProcDefNode*>(copyDefinition(proc)));
+        }
+    }
+    if (program->funcs) {
+        for (auto* func : program->funcs->elements) {
+            copy->funcs->elements.push_back(static_cast<FuncDefNode*>(copyDefinition(func)));
+        }
+    }
+    if (program->main) copy->main = static_cast<MainProgNode*>(copyDefinition(program->main));
+    return copy;
+}
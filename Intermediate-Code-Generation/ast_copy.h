@@ -0,0 +1,28 @@
+#ifndef AST_COPY_H
+#define AST_COPY_H
+
+#include <string>
+#include <map>
+#include "../ast.h"
+
+/**
+ * @brief Deep copies of checked ASTs. The Specializer copies bodies with
+ * literals substituted for parameters before folding them; a splc::Session
+ * copies the definitions it keeps, so the phases that rewrite an AST in place
+ * never touch the originals. Copies are owned by the caller.
+ */
+
+// Parameter -> literal it is replaced by
+typedef std::map<std::string, std::string> Substitution;
+
+ExpressionNode* copyExpression(const ExpressionNode* expr, const Substitution& subst = Substitution());
+AstNodeList<StatementNode>* copyStatements(const AstNodeList<StatementNode>* stmts,
+                                           const Substitution& subst = Substitution());
+AstNodeList<VarNode>* copyVariables(const AstNodeList<VarNode>* vars);
+
+// A definition of a program: its globals, a ProcDefNode, a FuncDefNode or its
+// MainProgNode; nullptr for any other node
+AstNode* copyDefinition(const AstNode* node);
+ProgramNode* copyProgram(const ProgramNode* program);
+
+#endif // AST_COPY_H
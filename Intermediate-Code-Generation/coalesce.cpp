@@ -0,0 +1,184 @@
+#include "optimizer.h"
+#include <algorithm>
+#include <numeric>
+
+// Union-find over variable ids
+static int findRoot(std::vector<int>& parent, int v) {
+    while (parent[v] != v) {
+        parent[v] = parent[parent[v]];
+        v = parent[v];
+    }
+    return v;
+}
+
+// The set of live variables while walking a block backwards, with O(1)
+// insert/remove and iteration over the members.
+class LiveSet {
+public:
+    explicit LiveSet(size_t size) : position(size, -1) {}
+
+    void insert(int v) {
+        if (position[v] != -1) return;
+        position[v] = static_cast<int>(members.size());
+        members.push_back(v);
+    }
+    void erase(int v) {
+        if (position[v] == -1) return;
+        int last = members.back();
+        members[position[v]] = last;
+        position[last] = position[v];
+        members.pop_back();
+        position[v] = -1;
+    }
+    void clear() {
+        for (int v : members) position[v] = -1;
+        members.clear();
+    }
+    const std::vector<int>& values() const { return members; }
+
+private:
+    std::vector<int> position;
+    std::vector<int> members;
+};
+
+/**
+ * @brief Register-allocation style coalescing of BASIC variables.
+ * newTemp() and newInlinedVar() never reuse a name, so large programs end up
+ * with tens of thousands of variables. Two variables interfere if one is
+ * assigned while the other is live (a copy does not make its source interfere
+ * with its target). Copy-related variables that do not interfere are merged
+ * first, which also removes the copies. The merged classes are then coloured
+ * greedily in program order, and every class of one colour shares a single
+ * name: the name of its earliest member.
+ */
+bool Optimizer::coalesceVariables() {
+    ControlFlowGraph cfg;
+    cfg.build(program);
+    if (cfg.blocks.empty()) return false;
+
+    VariableIndex vars;
+    // Number variables in order of first appearance so colouring follows the code
+    for (const auto& instr : program) {
+        for (const auto& name : instrUses(instr)) vars.id(name);
+        if (instr.kind == Instr::ASSIGN) vars.id(instr.dst);
+    }
+    size_t varCount = vars.names.size();
+    if (varCount == 0) return false;
+
+    Liveness liveness;
+    liveness.compute(program, cfg, vars);
+
+    // --- Interference graph ---
+    std::vector<std::vector<int>> adjacent(varCount);
+    auto addEdge = [&](int a, int b) {
+        if (a == b) return;
+        adjacent[a].push_back(b);
+        adjacent[b].push_back(a);
+    };
+
+    // Variables read before any assignment all hold their initial value at
+    // the start of the program: keep them apart.
+    const std::vector<int>& entryLive = liveness.liveIn[0];
+    for (size_t i = 0; i < entryLive.size(); ++i) {
+        for (size_t j = i + 1; j < entryLive.size(); ++j) addEdge(entryLive[i], entryLive[j]);
+    }
+
+    LiveSet live(varCount);
+    for (size_t b = 0; b < cfg.blocks.size(); ++b) {
+        live.clear();
+        for (int v : liveness.liveOut[b]) live.insert(v);
+
+        for (size_t i = cfg.blocks[b].last; i-- > cfg.blocks[b].first;) {
+            const Instr& instr = program[i];
+            if (instr.kind == Instr::ASSIGN) {
+                int dst = vars.id(instr.dst);
+                int copySource = (instr.op.empty() && isVariable(instr.a)) ? vars.id(instr.a) : -1;
+                for (int v : live.values()) {
+                    if (v != copySource) addEdge(dst, v);
+                }
+                live.erase(dst);
+            }
+            for (const auto& name : instrUses(instr)) live.insert(vars.id(name));
+        }
+    }
+    for (auto& neighbours : adjacent) {
+        std::sort(neighbours.begin(), neighbours.end());
+        neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+    }
+
+    // --- Coalesce copies ---
+    std::vector<int> parent(varCount);
+    std::iota(parent.begin(), parent.end(), 0);
+    std::vector<std::vector<int>> members(varCount);
+    for (size_t v = 0; v < varCount; ++v) members[v].push_back(static_cast<int>(v));
+
+    for (const auto& instr : program) {
+        if (instr.kind != Instr::ASSIGN || !instr.op.empty() || !isVariable(instr.a)) continue;
+        int a = findRoot(parent, vars.id(instr.dst));
+        int b = findRoot(parent, vars.id(instr.a));
+        if (a == b) continue;
+        if (members[a].size() < members[b].size()) std::swap(a, b);
+
+        bool interferes = false;
+        for (int member : members[b]) {
+            for (int neighbour : adjacent[member]) {
+                if (findRoot(parent, neighbour) == a) {
+                    interferes = true;
+                    break;
+                }
+            }
+            if (interferes) break;
+        }
+        if (interferes) continue;
+
+        parent[b] = a;
+        members[a].insert(members[a].end(), members[b].begin(), members[b].end());
+        members[b].clear();
+    }
+
+    // --- Greedy colouring of the merged classes ---
+    std::vector<int> colour(varCount, -1);
+    std::vector<int> colourName;     // Colour -> variable whose name it uses
+    std::vector<size_t> usedStamp;   // Colour -> last class that saw it on a neighbour
+    for (size_t v = 0; v < varCount; ++v) {
+        int root = findRoot(parent, static_cast<int>(v));
+        if (colour[root] != -1) continue;
+
+        for (int member : members[root]) {
+            for (int neighbour : adjacent[member]) {
+                int c = colour[findRoot(parent, neighbour)];
+                if (c != -1) usedStamp[c] = v + 1;
+            }
+        }
+        int chosen = 0;
+        while (chosen < static_cast<int>(usedStamp.size()) && usedStamp[chosen] == v + 1) ++chosen;
+        if (chosen == static_cast<int>(usedStamp.size())) {
+            usedStamp.push_back(0);
+            colourName.push_back(static_cast<int>(v));
+        }
+        colour[root] = chosen;
+    }
+
+    stats.variablesBefore = static_cast<int>(varCount);
+    stats.variablesAfter = static_cast<int>(colourName.size());
+    if (colourName.size() == varCount) return false;
+
+    // --- Rename ---
+    auto rename = [&](std::string& operand) {
+        if (!isVariable(operand)) return;
+        operand = vars.names[colourName[colour[findRoot(parent, vars.id(operand))]]];
+    };
+    std::vector<bool> deleted(program.size(), false);
+    for (size_t i = 0; i < program.size(); ++i) {
+        Instr& instr = program[i];
+        if (instr.kind == Instr::ASSIGN) rename(instr.dst);
+        if (instr.kind == Instr::ASSIGN || instr.kind == Instr::PRINT || instr.kind == Instr::IF) {
+            rename(instr.a);
+            rename(instr.b);
+        }
+        // Copies between merged variables are now no-ops
+        if (instr.kind == Instr::ASSIGN && instr.op.empty() && instr.a == instr.dst) deleted[i] = true;
+    }
+    removeDeleted(deleted);
+    return true;
+}
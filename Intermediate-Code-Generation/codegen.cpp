@@ -1,17 +1,24 @@
 #include "codegen.h"
+#include "parallel.h"
 #include <sstream>
 #include <fstream>
 #include <iostream>
 #include <regex>
 #include <cctype> // Needed for toupper
 
+// Lines per chunk below which post-processing stays on one thread
+static const size_t POSTPROCESS_MIN_CHUNK = 1 << 16;
+
 // =================== PUBLIC ===================
 
-void CodeGen::generate(ProgramNode* program) {
+void CodeGen::generate(ProgramNode* program, const Evaluator* evaluation) {
     code.clear();
     tempCounter = 0;
     labelCounter = 0;
     inlineCounter = 0;
+    // A shared Specializer keeps its copies: their bodies outlive this program
+    if (specializer == &ownSpecializer) specializer->clear();
+    else specializer->restart();
     astProgramRoot = program; // Store the root node
 
     if (!program) return;
@@ -19,21 +26,57 @@ void CodeGen::generate(ProgramNode* program) {
     // Generate main program code first
     if (program->main) {
         VarRenameMap emptyMap; // Main has no renames
-        genStatementList(program->main->statements, this->code, emptyMap);
+        if (!evaluation) {
+            genStatementList(program->main->statements, this->code, emptyMap);
+            return;
+        }
+
+        // What the evaluated statements printed, then where they left main
+        for (const auto& value : evaluation->getOutput()) emit("PRINT " + value);
+        if (evaluation->hasHalted()) {
+            emit("STOP");
+            return;
+        }
+        if (evaluation->isComplete()) return;
+        for (const auto& var : evaluation->getVariables()) {
+            emit("LET " + resolveVariable(var.first, emptyMap) + " = " + std::to_string(var.second));
+        }
+        const auto& statements = program->main->statements->elements;
+        for (size_t i = evaluation->getEvaluatedCount(); i < statements.size(); ++i) {
+            genStatement(statements[i], this->code, emptyMap);
+        }
     }
 }
 
-void CodeGen::saveCode() const {
-    std::ofstream outputFile("BASIC_EXECUTABLE.txt");
-    if (!outputFile.is_open()) {
-        std::cerr << "Could not open BASIC_EXECUTABLE.txt" << std::endl;
+void CodeGen::saveCode(const std::string& path) const {
+    OutputWriter out(path);
+    if (!out.isOpen()) {
+        std::cerr << "Could not open " << path << std::endl;
         return;
     }
-    for (const auto& line : code) {
-        outputFile << line << std::endl;
+    writeCode(out);
+    if (!out.close()) {
+        std::cerr << "Could not write " << path << std::endl;
+        return;
     }
-    std::cout << "Executable BASIC code successfully generated in BASIC_EXECUTABLE.txt" << std::endl;
-    outputFile.close();
+    std::cout << "Executable BASIC code successfully generated in " << path << std::endl;
+}
+
+void CodeGen::writeCode(OutputWriter& out) const {
+    // Every chunk of lines is rendered into its own buffer, in parallel on
+    // large programs; the writer takes the buffers over in order
+    const size_t chunks = chunkCount(code.size(), POSTPROCESS_MIN_CHUNK);
+    std::vector<std::string> buffers(chunks);
+    forEachChunk(code.size(), chunks, [&](size_t c, size_t begin, size_t end) {
+        size_t size = 0;
+        for (size_t i = begin; i < end; ++i) size += code[i].size() + 1;
+        buffers[c].reserve(size);
+        for (size_t i = begin; i < end; ++i) {
+            buffers[c] += code[i];
+            buffers[c] += '\n';
+        }
+    });
+    for (auto& buffer : buffers) out.adopt(std::move(buffer));
 }
 
 /**
@@ -64,6 +107,7 @@ void CodeGen::performInlining() {
     while(codeChanged) {
         codeChanged = false;
         newCode.clear();
+        ++inliningPasses;
 
         // Regex to find CALL commands
         std::regex callRegex(R"((?:(t\d+)\s*=\s*)?CALL_(\w+)\(([^)]*)\))");
@@ -111,7 +155,13 @@ void CodeGen::performInlining() {
                     }
                 }
 
+                // Literal arguments are substituted into a folded copy of the body
+                std::vector<bool> constantParam;
+                AstNodeList<StatementNode>* statements =
+                    specializer->bodyFor(funcName, funcParams, funcBody, callArgs, constantParam);
+
                 for (size_t i = 0; i < funcParams->elements.size(); ++i) {
+                    if (constantParam[i]) continue;
                     std::string paramName = funcParams->elements[i]->name;
                     std::string newParamName = newInlinedVar(paramName);
                     varMap[paramName] = newParamName;
@@ -130,7 +180,7 @@ void CodeGen::performInlining() {
                 // 5. Generate the inlined body
                 // We pass the map, and the assignmentVar (e.g., "t9")
                 // which will be used to replace the "return" statement.
-                genStatementList(funcBody->statements, newCode, varMap, assignmentVar);
+                genStatementList(statements, newCode, varMap, assignmentVar);
 
             } else {
                 // Not a CALL line, just copy it over
@@ -244,12 +294,13 @@ void CodeGen::genStatement(StatementNode* stmt, std::vector<std::string>& codeBl
         std::string labelStart = newLabel("LBL_WHILE");
         std::string labelExit = newLabel("LBL_EXIT_WHILE");
 
-        emit("REM " + labelStart, codeBlock);
+        // Rotated: a guard test on entry, then the loop tests at the bottom, so
+        // an iteration costs one conditional jump back instead of IF + GOTO.
         genCondition(whileNode->condition, codeBlock, varMap, labelStart + "_BODY", labelExit);
 
         emit("REM " + labelStart + "_BODY", codeBlock);
         genStatementList(whileNode->body, codeBlock, varMap, funcReturnVar);
-        emit("GOTO " + labelStart, codeBlock);
+        genCondition(whileNode->condition, codeBlock, varMap, labelStart + "_BODY", labelExit);
 
         emit("REM " + labelExit, codeBlock);
     }
@@ -305,18 +356,20 @@ std::string CodeGen::genExpression(ExpressionNode* expr, std::vector<std::string
         return "\"" + stringNode->value + "\"";
     }
 
+    if (auto* boolNode = dynamic_cast<BoolNode*>(expr)) {
+        return boolNode->value ? "-1" : "0"; // BASIC truth values
+    }
+
     if (auto* unary = dynamic_cast<UnaryOpNode*>(expr)) {
         std::string operand = genExpression(unary->operand, codeBlock, varMap);
         std::string tmp = newTemp();
 
         // BASIC uses operators differently
-        if (unary->op == "neg") emit(tmp + " = -" + operand, codeBlock);
+        if (unary->op == "neg") emit("LET " + tmp + " = -" + operand, codeBlock);
         // BASIC doesn't have a direct '!', we handle 'not' in genCondition
         else if (unary->op == "not") {
              // For safety, generate a temporary boolean representation if needed outside condition
-            std::string zero = newTemp();
-            emit(zero + " = 0", codeBlock);
-            emit("LET " + tmp + " = (" + operand + " = " + zero + ")", codeBlock); // tmp = -1 if operand is 0, else 0
+            emit("LET " + tmp + " = (" + operand + " = 0)", codeBlock); // tmp = -1 if operand is 0, else 0
         }
         else emit("LET " + tmp + " = " + unary->op + " " + operand, codeBlock); // Should not happen?
 
@@ -385,45 +438,53 @@ void CodeGen::genCondition(ExpressionNode* expr, std::vector<std::string>& codeB
                            const std::string& labelFalse) {
     if (!expr) return;
 
+    // Folded by ConstantFolder: only one of the two targets is reachable
+    if (auto* boolNode = dynamic_cast<BoolNode*>(expr)) {
+        emit("GOTO " + (boolNode->value ? labelTrue : labelFalse), codeBlock);
+        return;
+    }
+
     if (auto* binary = dynamic_cast<BinaryOpNode*>(expr)) {
-        std::string op;
-        bool useExpressionResult = false; // Flag for AND/OR
+        // AND/OR jump straight to a target as soon as the outcome is known:
+        // the right operand is only evaluated if the left one did not decide.
+        if (binary->op == "and") {
+            std::string labelRight = newLabel("LBL_AND");
+            genCondition(binary->left, codeBlock, varMap, labelRight, labelFalse);
+            emit("REM " + labelRight, codeBlock);
+            genCondition(binary->right, codeBlock, varMap, labelTrue, labelFalse);
+            return;
+        }
+        if (binary->op == "or") {
+            std::string labelRight = newLabel("LBL_OR");
+            genCondition(binary->left, codeBlock, varMap, labelTrue, labelRight);
+            emit("REM " + labelRight, codeBlock);
+            genCondition(binary->right, codeBlock, varMap, labelTrue, labelFalse);
+            return;
+        }
 
+        std::string op;
         if (binary->op == "eq") op = " = ";
         else if (binary->op == "ne") op = " <> ";
         else if (binary->op == "gt" || binary->op == ">") op = " > ";
         else if (binary->op == "lt" || binary->op == "<") op = " < ";
         else if (binary->op == "ge") op = " >= ";
         else if (binary->op == "le") op = " <= ";
-        // For AND/OR, we evaluate the whole expression first
-        else if (binary->op == "and") { useExpressionResult = true; }
-        else if (binary->op == "or") { useExpressionResult = true; }
         else { // Should not happen for conditions
              emit("# ERROR: Invalid operator in condition: " + binary->op, codeBlock);
              return;
         }
 
-        if (useExpressionResult) {
-            // Evaluate the whole AND/OR expression into a temporary
-             std::string condResult = genExpression(expr, codeBlock, varMap);
-             // BASIC uses -1 for true, 0 for false. Check if result is not 0.
-             std::string zero = newTemp();
-             emit("LET " + zero + " = 0", codeBlock);
-             emit("IF " + condResult + " <> " + zero + " THEN " + labelTrue, codeBlock);
-        } else {
-             // Handle standard comparisons
-            std::string left = genExpression(binary->left, codeBlock, varMap);
-            std::string right = genExpression(binary->right, codeBlock, varMap);
-
-            std::string tmpLeft = newTemp();
-            emit("LET " + tmpLeft + " = " + left, codeBlock);
-
-            std::string tmpRight = newTemp();
-            emit("LET " + tmpRight + " = " + right, codeBlock);
-
-            emit("IF " + tmpLeft + op + tmpRight + " THEN " + labelTrue, codeBlock);
-        }
+        // Handle standard comparisons
+        std::string left = genExpression(binary->left, codeBlock, varMap);
+        std::string right = genExpression(binary->right, codeBlock, varMap);
+
+        std::string tmpLeft = newTemp();
+        emit("LET " + tmpLeft + " = " + left, codeBlock);
+
+        std::string tmpRight = newTemp();
+        emit("LET " + tmpRight + " = " + right, codeBlock);
 
+        emit("IF " + tmpLeft + op + tmpRight + " THEN " + labelTrue, codeBlock);
         emit("GOTO " + labelFalse, codeBlock);
         return;
     }
@@ -439,9 +500,7 @@ void CodeGen::genCondition(ExpressionNode* expr, std::vector<std::string>& codeB
     // Fallback (e.g., a single variable or number as a condition)
     // Check if the value is non-zero (true in BASIC)
     std::string cond = genExpression(expr, codeBlock, varMap);
-    std::string zero = newTemp();
-    emit("LET " + zero + " = 0", codeBlock);
-    emit("IF " + cond + " <> " + zero + " THEN " + labelTrue, codeBlock);
+    emit("IF " + cond + " <> 0 THEN " + labelTrue, codeBlock);
     emit("GOTO " + labelFalse, codeBlock);
 }
 
@@ -479,144 +538,122 @@ std::string CodeGen::toString() const {
     return codestring;
 }
 
-void CodeGen::saveToHTML() const {
-    std::stringstream htmlContent;
-    htmlContent << "<!DOCTYPE html>\n"
-                << "<html>\n"
-                << "<head><title>Generated BASIC Code</title></head>\n" // Changed title
-                << "<body>\n"
-                << "<h1>Generated BASIC Code</h1>\n"
-                << "<pre><code>\n";
-
-    for (const std::string& line : code) {
-        htmlContent << line << "\n";
+void CodeGen::saveToHTML(const std::string& path) const {
+    OutputWriter out(path);
+    if (!out.isOpen()) {
+        std::cerr << "Error: Unable to open " << path << " for writing.\n";
+        return;
+    }
+    writeHTML(out);
+    if (!out.close()) {
+        std::cerr << "Error: Unable to write " << path << "\n";
+        return;
     }
+    // Updated message
+    std::cout << "HTML preview of generated code saved to " << path << std::endl;
+}
 
-    htmlContent << "</code></pre>\n" << "</body>\n" << "</html>\n";
+void CodeGen::writeHTML(OutputWriter& out) const {
+    out.write("<!DOCTYPE html>\n"
+              "<html>\n"
+              "<head><title>Generated BASIC Code</title></head>\n" // Changed title
+              "<body>\n"
+              "<h1>Generated BASIC Code</h1>\n"
+              "<pre><code>\n");
 
-    std::ofstream outputFile("ICG.html");
-    if (outputFile.is_open()) {
-        outputFile << htmlContent.str();
-        outputFile.close();
-        // Updated message
-        std::cout << "HTML preview of generated code saved to ICG.html" << std::endl;
-    } else {
-        std::cerr << "Error: Unable to open file for writing.\n";
+    for (const std::string& line : code) {
+        out.writeLine(line);
     }
+
+    out.write("</code></pre>\n"
+              "</body>\n"
+              "</html>\n");
 }
 
 // ------------------- Post Processing -------------------
 
 void CodeGen::startPostProcess(){
-    // Add line number
-    int number = 0;
-    std::vector<std::string> numberedCode;
-    for (auto& line : this->code) {
-        if(!line.empty()){
-            number += 10;
-            numberedCode.push_back(std::to_string(number) + " " + line);
+    // Instructions are numbered 10, 20, ... Label lines (REM LBL_...) do not get
+    // a line of their own: a jump to a label goes straight to the next real
+    // instruction. Each label gets a dense id, and labelLines[id] its line.
+    // On large programs each phase runs over chunks of the code in parallel.
+    const size_t n = this->code.size();
+    const size_t chunks = chunkCount(n, POSTPROCESS_MIN_CHUNK);
+
+    // Per chunk: its instructions, and its labels as (line index, instructions
+    // of the chunk before the label)
+    std::vector<size_t> counts(chunks, 0);
+    std::vector<std::vector<std::pair<size_t, size_t>>> chunkLabels(chunks);
+    forEachChunk(n, chunks, [&](size_t c, size_t begin, size_t end) {
+        for (size_t index = begin; index < end; ++index) {
+            const std::string& line = this->code[index];
+            if (line.empty()) continue;
+            if (isLabelLine(line)) chunkLabels[c].push_back({index, counts[c]});
+            else ++counts[c];
+        }
+    });
+
+    // Instructions before each chunk: a prefix sum over the chunk counts
+    std::vector<size_t> offsets(chunks, 0);
+    for (size_t c = 1; c < chunks; ++c) offsets[c] = offsets[c - 1] + counts[c - 1];
+    const size_t instructions = offsets[chunks - 1] + counts[chunks - 1];
+
+    // Label ids in program order; labels after the last instruction still
+    // need a line to land on
+    labelIds.clear();
+    labelLines.clear();
+    bool trailing = false;
+    size_t trailingLine = 0; // Index in code of the first of those labels
+    for (size_t c = 0; c < chunks; ++c) {
+        for (const auto& label : chunkLabels[c]) {
+            size_t before = offsets[c] + label.second;
+            labelIds.emplace(this->code[label.first].substr(4), static_cast<int>(labelLines.size()));
+            labelLines.push_back(static_cast<int>(before + 1) * 10);
+            if (before == instructions && !trailing) {
+                trailing = true;
+                trailingLine = label.first;
+            }
         }
-    }
-    this->code = numberedCode;
-
-    // Save Labels
-    lineLabelMap.clear();
-    for (const auto& line : this->code) {
-        gatherLabel(line);
     }
 
-    for (auto& line : this->code) {
-        changeLabelToLineNumber(line);
-    }
-    return;
+    // Each chunk writes its instructions into their own slots, with the number
+    // in front and the line of the jump target in place of the label
+    std::vector<std::string> numberedCode(instructions + (trailing ? 1 : 0));
+    forEachChunk(n, chunks, [&](size_t c, size_t begin, size_t end) {
+        size_t slot = offsets[c];
+        for (size_t index = begin; index < end; ++index) {
+            const std::string& line = this->code[index];
+            if (line.empty() || isLabelLine(line)) continue;
+            std::string numbered = std::to_string((slot + 1) * 10);
+            numbered += ' ';
+            size_t target = jumpTarget(line);
+            auto it = target == std::string::npos ? labelIds.end() : labelIds.find(line.substr(target));
+            if (it != labelIds.end()) {
+                numbered.append(line, 0, target);
+                numbered += std::to_string(labelLines[it->second]);
+            } else {
+                numbered += line;
+            }
+            numberedCode[slot++] = std::move(numbered);
+        }
+    });
+    if (trailing) numberedCode.back() = std::to_string((instructions + 1) * 10) + " " + this->code[trailingLine];
+    this->code = std::move(numberedCode);
 }
 
-void CodeGen::gatherLabel(const std::string line){
-    std::istringstream iss(line);
-    std::string token;
-    std::vector<std::string> tokens;
-
-    // Split line into separate strings
-    while (iss >> token) {
-        tokens.push_back(token);
-    }
-    // Any line with less than 3 words and numbers doesn't have labels
-    if (tokens.size() < 3) {
-        return;
-    }
-
-    // First token should be a number
-    int lineNumber;
-    try {
-        lineNumber = std::stoi(tokens[0]);
-    } catch (...) {
-        return;
-    }
-
-    if (tokens[1] != "REM") {
-        return;
-    }
-
-    if (tokens[tokens.size() - 1].find("LBL") != std::string::npos ) {
-        lineLabelMap[tokens[tokens.size() - 1]] = lineNumber;
-        return;
-    }
-
+bool CodeGen::isLabelLine(const std::string& line) const {
+    // A label line is exactly "REM <label>"
+    return line.compare(0, 4, "REM ") == 0 && line.size() > 4 &&
+           line.find(' ', 4) == std::string::npos && line.find("LBL", 4) != std::string::npos;
 }
 
-void CodeGen::changeLabelToLineNumber(std::string &line){
-    std::istringstream iss(line);
-    std::string token;
-    std::vector<std::string> tokens;
-
-    // Split line into separate strings with a delimiter of a whitespace
-    while (iss >> token) {
-        tokens.push_back(token);
-    }
-
-    if (tokens.size() < 2) { // Need at least line number and command
-        return;
-    }
-
-    // First token should be a number
-    int lineNumberFromToken;
-    try {
-        lineNumberFromToken = std::stoi(tokens[0]);
-    } catch (...) {
-        return;
-    }
-
-    // Check the last token (for GOTO) or third-to-last (for IF THEN)
-    std::string targetLabel = "";
-    size_t labelPos = std::string::npos;
-
-    // Check for GOTO Label
-    // Ensure there are enough tokens before checking indices
-    if (tokens.size() >= 3 && tokens[tokens.size() - 2] == "GOTO") {
-        targetLabel = tokens[tokens.size() - 1];
-        labelPos = tokens.size() - 1;
-    }
-    // Check for IF ... THEN Label
-    // Ensure there are enough tokens before checking indices
-    else if (tokens.size() >= 5 && tokens[tokens.size() - 2] == "THEN") {
-         targetLabel = tokens[tokens.size() - 1];
-         labelPos = tokens.size() - 1;
-    }
-
-    if (!targetLabel.empty() && lineLabelMap.count(targetLabel)) {
-        // Only modify if it's a jump (don't modify the REM line itself)
-        // Check if the command is REM
-         if (tokens[1] != "REM") {
-             line = "";
-            for(size_t i = 0; i < labelPos; i++){
-                line += tokens[i] + " ";
-            };
-            line += std::to_string(lineLabelMap.at(targetLabel));
-            // Add remaining parts of the line if any (shouldn't be for GOTO/THEN)
-            for (size_t i = labelPos + 1; i < tokens.size(); ++i) {
-                line += " " + tokens[i];
-            }
-            return;
-        }
-    }
-}
\ No newline at end of file
+size_t CodeGen::jumpTarget(const std::string& line) const {
+    // "GOTO <label>" or "IF ... THEN <label>": the label is the last word
+    size_t space = line.rfind(' ');
+    if (space == std::string::npos || space == 0) return std::string::npos;
+    size_t keyword = line.rfind(' ', space - 1);
+    keyword = (keyword == std::string::npos) ? 0 : keyword + 1;
+    if (line.compare(keyword, space - keyword, "GOTO") == 0) return space + 1;
+    if (line.compare(keyword, space - keyword, "THEN") == 0 && line.compare(0, 3, "IF ") == 0) return space + 1;
+    return std::string::npos;
+}
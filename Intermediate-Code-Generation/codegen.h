@@ -4,8 +4,12 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include "../ast.h"
 #include "../type_checker.h"
+#include "specialize.h"
+#include "evaluator.h"
+#include "writer.h"
 
 // Define a type for the variable rename map
 typedef std::map<std::string, std::string> VarRenameMap;
@@ -13,29 +17,43 @@ typedef std::map<std::string, std::string> VarRenameMap;
 class CodeGen {
 public:
     std::vector<std::string> code;
-    std::map<std::string, int> lineLabelMap;
 
     CodeGen(const SymbolTable* symtab = nullptr) : symbolTable(symtab) {}
 
     // --- Main Public API ---
-    void generate(ProgramNode* program);
+    // With an evaluation, the part of main it evaluated is replaced by its
+    // output and the values it left in main's variables
+    void generate(ProgramNode* program, const Evaluator* evaluation = nullptr);
     void performInlining();
     void startPostProcess();
     
-    void saveCode() const;
+    void saveCode(const std::string& path = "BASIC_EXECUTABLE.txt") const;
+    // Renders the code (or its HTML preview) into a writer, e.g. one on stdout
+    void writeCode(OutputWriter& out) const;
+    void writeHTML(OutputWriter& out) const;
     void printCode() const;
     std::string toString() const;
 
     void setSymbolTable(const SymbolTable* symtab) { symbolTable = symtab; }
-    void saveToHTML() const;
+    void saveToHTML(const std::string& path = "ICG.html") const;
+    // Specialised bodies come from shared, which keeps them for later compiles,
+    // instead of from a Specializer of this CodeGen's own
+    void setSpecializer(Specializer* shared) { specializer = shared ? shared : &ownSpecializer; }
+    int getSpecializationCount() const { return specializer->getVersionCount(); }
+    int getInliningPassCount() const { return inliningPasses; }
+    // Labels the last post-processing resolved
+    size_t getLabelCount() const { return labelLines.size(); }
 
 
 private:
     int tempCounter = 0;
     int labelCounter = 0;  
     int inlineCounter = 0; // For unique variable renaming during inlining
+    int inliningPasses = 0; // Rounds performInlining made over the code
     const SymbolTable* symbolTable; 
     ProgramNode* astProgramRoot = nullptr; // Store root for lookups
+    Specializer ownSpecializer;            // Bodies folded for constant arguments
+    Specializer* specializer = &ownSpecializer;
 
     // --- Inlining Helpers ---
     std::string newInlinedVar(const std::string& varName);
@@ -60,8 +78,11 @@ private:
     std::string resolveVariable(const std::string& name, VarRenameMap& varMap);
 
     // --- Post-Processing Helpers ---
-    void gatherLabel(const std::string line);
-    void changeLabelToLineNumber(std::string &line);
+    std::unordered_map<std::string, int> labelIds; // Label -> dense id
+    std::vector<int> labelLines;                   // Id -> line number it resolves to
+    bool isLabelLine(const std::string& line) const;
+    // Position of the label a GOTO or IF ... THEN jumps to, npos if there is none
+    size_t jumpTarget(const std::string& line) const;
 };
 
 #endif // CODEGEN_H
\ No newline at end of file
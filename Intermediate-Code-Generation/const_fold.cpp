@@ -0,0 +1,454 @@
+#include "const_fold.h"
+#include <cctype>
+
+// =================== Integer Semantics ===================
+
+bool evalSplBinary(const std::string& op, long long a, long long b, long long& result) {
+    long long value;
+    if (op == "plus") value = a + b;
+    else if (op == "minus") value = a - b;
+    else if (op == "mult") value = a * b;
+    else if (op == "div") {
+        // Only exact quotients are folded; anything else is left to the interpreter
+        if (b == 0 || a % b != 0) return false;
+        value = a / b;
+    }
+    else if (op == "eq") value = (a == b);
+    else if (op == ">") value = (a > b);
+    else if (op == "and") value = (a != 0 && b != 0);
+    else if (op == "or") value = (a != 0 || b != 0);
+    else return false;
+
+    if (value < SPL_INT_MIN || value > SPL_INT_MAX) return false;
+    result = value;
+    return true;
+}
+
+bool evalBasicBinary(const std::string& op, long long a, long long b, long long& result) {
+    long long value;
+    if (op == "+") value = a + b;
+    else if (op == "-") value = a - b;
+    else if (op == "*") value = a * b;
+    else if (op == "/") {
+        if (b == 0 || a % b != 0) return false;
+        value = a / b;
+    }
+    else if (op == "=") value = (a == b) ? -1 : 0;
+    else if (op == "<>") value = (a != b) ? -1 : 0;
+    else if (op == ">") value = (a > b) ? -1 : 0;
+    else if (op == "<") value = (a < b) ? -1 : 0;
+    else if (op == ">=") value = (a >= b) ? -1 : 0;
+    else if (op == "<=") value = (a <= b) ? -1 : 0;
+    else if (op == "AND") value = a & b;
+    else if (op == "OR") value = a | b;
+    else return false;
+
+    if (value < SPL_INT_MIN || value > SPL_INT_MAX) return false;
+    result = value;
+    return true;
+}
+
+bool constantValue(const ExpressionNode* expr, long long& value) {
+    auto* number = dynamic_cast<const NumberNode*>(expr);
+    if (!number || number->value.empty()) return false;
+
+    const std::string& text = number->value;
+    size_t start = (text[0] == '-') ? 1 : 0;
+    if (start == text.size() || text.size() - start > 10) return false;
+    long long magnitude = 0;
+    for (size_t i = start; i < text.size(); ++i) {
+        if (!std::isdigit(static_cast<unsigned char>(text[i]))) return false;
+        magnitude = magnitude * 10 + (text[i] - '0');
+    }
+    long long v = start ? -magnitude : magnitude;
+    if (v < SPL_INT_MIN || v > SPL_INT_MAX) return false;
+    value = v;
+    return true;
+}
+
+// =================== Helpers ===================
+
+static ExpressionNode* makeNumber(long long value) {
+    return new NumberNode(std::to_string(value));
+}
+
+// Detaches a child from its parent so the parent can be deleted without it
+static ExpressionNode* take(ExpressionNode*& slot) {
+    ExpressionNode* expr = slot;
+    slot = nullptr;
+    return expr;
+}
+
+// SPL terms have no side effects; the only thing that can go wrong at run time
+// is a division, so a subterm may only be discarded if it contains none that
+// could fail.
+static bool canTrap(const ExpressionNode* expr) {
+    if (auto* unary = dynamic_cast<const UnaryOpNode*>(expr)) {
+        return canTrap(unary->operand);
+    }
+    if (auto* binary = dynamic_cast<const BinaryOpNode*>(expr)) {
+        if (binary->op == "div") {
+            long long divisor;
+            if (!constantValue(binary->right, divisor) || divisor == 0) return true;
+        }
+        return canTrap(binary->left) || canTrap(binary->right);
+    }
+    return false;
+}
+
+static bool sameExpression(const ExpressionNode* a, const ExpressionNode* b) {
+    if (!a || !b) return false;
+    if (auto* va = dynamic_cast<const VarNode*>(a)) {
+        auto* vb = dynamic_cast<const VarNode*>(b);
+        return vb && va->name == vb->name;
+    }
+    if (auto* na = dynamic_cast<const NumberNode*>(a)) {
+        auto* nb = dynamic_cast<const NumberNode*>(b);
+        return nb && na->value == nb->value;
+    }
+    if (auto* ba = dynamic_cast<const BoolNode*>(a)) {
+        auto* bb = dynamic_cast<const BoolNode*>(b);
+        return bb && ba->value == bb->value;
+    }
+    if (auto* ua = dynamic_cast<const UnaryOpNode*>(a)) {
+        auto* ub = dynamic_cast<const UnaryOpNode*>(b);
+        return ub && ua->op == ub->op && sameExpression(ua->operand, ub->operand);
+    }
+    if (auto* ba = dynamic_cast<const BinaryOpNode*>(a)) {
+        auto* bb = dynamic_cast<const BinaryOpNode*>(b);
+        return bb && ba->op == bb->op && sameExpression(ba->left, bb->left) && sameExpression(ba->right, bb->right);
+    }
+    return false;
+}
+
+// =================== PUBLIC ===================
+
+void ConstantFolder::fold(ProgramNode* program) {
+    if (!program) return;
+
+    if (program->procs) {
+        for (auto* proc : program->procs->elements) {
+            if (proc->body) foldStatementList(proc->body->statements);
+        }
+    }
+    if (program->funcs) {
+        for (auto* func : program->funcs->elements) {
+            if (func->body) foldStatementList(func->body->statements);
+        }
+    }
+    if (program->main) {
+        foldStatementList(program->main->statements);
+    }
+}
+
+// =================== PRIVATE ===================
+
+// ------------------- Statements -------------------
+
+void ConstantFolder::foldStatementList(AstNodeList<StatementNode>* stmts) {
+    if (!stmts) return;
+
+    std::vector<StatementNode*> folded;
+    for (auto* stmt : stmts->elements) {
+        // A branch with a known condition is replaced by the statements it runs
+        AstNodeList<StatementNode>* taken = nullptr;
+        bool drop = false;
+
+        if (auto* assign = dynamic_cast<AssignNode*>(stmt)) {
+            assign->expression = foldExpression(assign->expression);
+        }
+        else if (auto* print = dynamic_cast<PrintNode*>(stmt)) {
+            print->expression = foldExpression(print->expression);
+        }
+        else if (auto* ifNode = dynamic_cast<IfNode*>(stmt)) {
+            ifNode->condition = foldExpression(ifNode->condition);
+            foldStatementList(ifNode->then_branch);
+            if (auto* cond = dynamic_cast<BoolNode*>(ifNode->condition)) {
+                if (cond->value) std::swap(taken, ifNode->then_branch);
+                drop = true;
+            }
+        }
+        else if (auto* ifElseNode = dynamic_cast<IfElseNode*>(stmt)) {
+            ifElseNode->condition = foldExpression(ifElseNode->condition);
+            foldStatementList(ifElseNode->then_branch);
+            foldStatementList(ifElseNode->else_branch);
+            if (auto* cond = dynamic_cast<BoolNode*>(ifElseNode->condition)) {
+                if (cond->value) std::swap(taken, ifElseNode->then_branch);
+                else std::swap(taken, ifElseNode->else_branch);
+                drop = true;
+            }
+        }
+        else if (auto* whileNode = dynamic_cast<WhileNode*>(stmt)) {
+            whileNode->condition = foldExpression(whileNode->condition);
+            foldStatementList(whileNode->body);
+            auto* cond = dynamic_cast<BoolNode*>(whileNode->condition);
+            drop = cond && !cond->value;
+        }
+        else if (auto* doUntilNode = dynamic_cast<DoUntilNode*>(stmt)) {
+            foldStatementList(doUntilNode->body);
+            doUntilNode->condition = foldExpression(doUntilNode->condition);
+            // until true: the body runs exactly once
+            auto* cond = dynamic_cast<BoolNode*>(doUntilNode->condition);
+            if (cond && cond->value) {
+                std::swap(taken, doUntilNode->body);
+                drop = true;
+            }
+        }
+
+        if (taken) {
+            folded.insert(folded.end(), taken->elements.begin(), taken->elements.end());
+            taken->elements.clear();
+            delete taken;
+        }
+        if (drop) {
+            delete stmt;
+            ++foldCount;
+        } else {
+            folded.push_back(stmt);
+        }
+    }
+    stmts->elements = folded;
+}
+
+// ------------------- Expressions -------------------
+
+ExpressionNode* ConstantFolder::replace(ExpressionNode* oldExpr, ExpressionNode* newExpr) {
+    delete oldExpr;
+    ++foldCount;
+    return newExpr;
+}
+
+ExpressionNode* ConstantFolder::foldExpression(ExpressionNode* expr) {
+    if (auto* unary = dynamic_cast<UnaryOpNode*>(expr)) {
+        return foldUnary(unary);
+    }
+    if (auto* binary = dynamic_cast<BinaryOpNode*>(expr)) {
+        return foldBinary(binary);
+    }
+    return expr; // Atoms, strings and calls (whose arguments are atoms)
+}
+
+ExpressionNode* ConstantFolder::foldUnary(UnaryOpNode* unary) {
+    unary->operand = foldExpression(unary->operand);
+
+    if (unary->op == "neg") {
+        long long value;
+        if (constantValue(unary->operand, value) && value != SPL_INT_MIN) {
+            return replace(unary, makeNumber(-value));
+        }
+        auto* inner = dynamic_cast<UnaryOpNode*>(unary->operand);
+        if (inner && inner->op == "neg") {
+            return replace(unary, take(inner->operand));
+        }
+    }
+    else if (unary->op == "not") {
+        if (auto* cond = dynamic_cast<BoolNode*>(unary->operand)) {
+            return replace(unary, new BoolNode(!cond->value));
+        }
+        auto* inner = dynamic_cast<UnaryOpNode*>(unary->operand);
+        if (inner && inner->op == "not") {
+            return replace(unary, take(inner->operand));
+        }
+    }
+    return unary;
+}
+
+ExpressionNode* ConstantFolder::foldBinary(BinaryOpNode* binary) {
+    binary->left = foldExpression(binary->left);
+    binary->right = foldExpression(binary->right);
+
+    const std::string& op = binary->op;
+    if (op == "plus" || op == "minus") return foldSum(binary);
+    if (op == "mult") return foldProduct(binary);
+
+    long long left, right, value;
+    bool leftConst = constantValue(binary->left, left);
+    bool rightConst = constantValue(binary->right, right);
+
+    if (op == "div") {
+        if (leftConst && rightConst && evalSplBinary(op, left, right, value)) {
+            return replace(binary, makeNumber(value));
+        }
+        if (rightConst && right == 1) {
+            return replace(binary, take(binary->left));
+        }
+        return binary;
+    }
+
+    if (op == "eq" || op == ">") {
+        if (leftConst && rightConst && evalSplBinary(op, left, right, value)) {
+            return replace(binary, new BoolNode(value != 0));
+        }
+        if (!canTrap(binary->left) && sameExpression(binary->left, binary->right)) {
+            return replace(binary, new BoolNode(op == "eq"));
+        }
+        return binary;
+    }
+
+    if (op == "and" || op == "or") {
+        bool isAnd = (op == "and");
+        auto* leftBool = dynamic_cast<BoolNode*>(binary->left);
+        auto* rightBool = dynamic_cast<BoolNode*>(binary->right);
+
+        if (leftBool && rightBool) {
+            bool value = isAnd ? (leftBool->value && rightBool->value) : (leftBool->value || rightBool->value);
+            return replace(binary, new BoolNode(value));
+        }
+        // true is the identity of and, false the identity of or; the other
+        // value absorbs the whole term.
+        if (leftBool) {
+            if (leftBool->value == isAnd) return replace(binary, take(binary->right));
+            if (!canTrap(binary->right)) return replace(binary, new BoolNode(!isAnd));
+        }
+        if (rightBool) {
+            if (rightBool->value == isAnd) return replace(binary, take(binary->left));
+            if (!canTrap(binary->left)) return replace(binary, new BoolNode(!isAnd));
+        }
+        if (!canTrap(binary->left) && sameExpression(binary->left, binary->right)) {
+            return replace(binary, take(binary->left));
+        }
+    }
+    return binary;
+}
+
+void ConstantFolder::collectSum(ExpressionNode** slot, bool negated, std::vector<ChainTerm>& terms,
+                                std::vector<long long>& constants, bool& restructured) {
+    ExpressionNode* expr = *slot;
+    auto* binary = dynamic_cast<BinaryOpNode*>(expr);
+    if (binary && (binary->op == "plus" || binary->op == "minus")) {
+        collectSum(&binary->left, negated, terms, constants, restructured);
+        collectSum(&binary->right, negated != (binary->op == "minus"), terms, constants, restructured);
+        return;
+    }
+    auto* unary = dynamic_cast<UnaryOpNode*>(expr);
+    if (unary && unary->op == "neg") {
+        restructured = true;
+        collectSum(&unary->operand, !negated, terms, constants, restructured);
+        return;
+    }
+    long long value;
+    if (constantValue(expr, value) && !(negated && value == SPL_INT_MIN)) {
+        constants.push_back(negated ? -value : value);
+        return;
+    }
+    terms.push_back({slot, negated});
+}
+
+// Flattens a plus/minus chain into signed terms plus one constant, e.g.
+// ((x plus 3) minus (neg 4)) becomes (x plus 7).
+ExpressionNode* ConstantFolder::foldSum(BinaryOpNode* binary) {
+    std::vector<ChainTerm> terms;
+    std::vector<long long> constants;
+    bool restructured = false;
+    collectSum(&binary->left, false, terms, constants, restructured);
+    collectSum(&binary->right, binary->op == "minus", terms, constants, restructured);
+
+    long long constant = 0;
+    for (long long value : constants) {
+        if (!evalSplBinary("plus", constant, value, constant)) return binary; // Overflow: leave it to run time
+    }
+
+    // x and (neg x) cancel out
+    std::vector<bool> cancelled(terms.size(), false);
+    for (size_t i = 0; i < terms.size(); ++i) {
+        if (cancelled[i] || canTrap(*terms[i].slot)) continue;
+        for (size_t j = i + 1; j < terms.size(); ++j) {
+            if (!cancelled[j] && terms[j].negated != terms[i].negated && sameExpression(*terms[i].slot, *terms[j].slot)) {
+                cancelled[i] = cancelled[j] = true;
+                restructured = true;
+                break;
+            }
+        }
+    }
+
+    bool rebuild = restructured || constants.size() > 1 || (constants.size() == 1 && constant == 0);
+    if (!rebuild) return binary;
+
+    ExpressionNode* result = nullptr;
+    for (size_t i = 0; i < terms.size(); ++i) {
+        if (cancelled[i] || terms[i].negated) continue;
+        ExpressionNode* term = take(*terms[i].slot);
+        result = result ? new BinaryOpNode(result, "plus", term) : term;
+    }
+    for (size_t i = 0; i < terms.size(); ++i) {
+        if (cancelled[i] || !terms[i].negated) continue;
+        ExpressionNode* term = take(*terms[i].slot);
+        if (!result) {
+            if (constant == 0) {
+                result = new UnaryOpNode("neg", term);
+                continue;
+            }
+            result = makeNumber(constant);
+            constant = 0;
+        }
+        result = new BinaryOpNode(result, "minus", term);
+    }
+
+    if (!result) result = makeNumber(constant);
+    else if (constant > 0) result = new BinaryOpNode(result, "plus", makeNumber(constant));
+    else if (constant < 0 && constant != SPL_INT_MIN) result = new BinaryOpNode(result, "minus", makeNumber(-constant));
+    else if (constant < 0) result = new BinaryOpNode(result, "plus", makeNumber(constant));
+
+    return replace(binary, result);
+}
+
+void ConstantFolder::collectProduct(ExpressionNode** slot, std::vector<ChainTerm>& factors,
+                                    std::vector<long long>& constants, bool& restructured) {
+    ExpressionNode* expr = *slot;
+    auto* binary = dynamic_cast<BinaryOpNode*>(expr);
+    if (binary && binary->op == "mult") {
+        collectProduct(&binary->left, factors, constants, restructured);
+        collectProduct(&binary->right, factors, constants, restructured);
+        return;
+    }
+    auto* unary = dynamic_cast<UnaryOpNode*>(expr);
+    if (unary && unary->op == "neg") {
+        restructured = true;
+        constants.push_back(-1);
+        collectProduct(&unary->operand, factors, constants, restructured);
+        return;
+    }
+    long long value;
+    if (constantValue(expr, value)) {
+        constants.push_back(value);
+        return;
+    }
+    factors.push_back({slot, false});
+}
+
+// Flattens a mult chain into its factors times one constant, e.g.
+// ((2 mult x) mult 3) becomes (x mult 6) and (x mult 1) becomes x.
+ExpressionNode* ConstantFolder::foldProduct(BinaryOpNode* binary) {
+    std::vector<ChainTerm> factors;
+    std::vector<long long> constants;
+    bool restructured = false;
+    collectProduct(&binary->left, factors, constants, restructured);
+    collectProduct(&binary->right, factors, constants, restructured);
+
+    long long constant = 1;
+    for (long long value : constants) {
+        if (!evalSplBinary("mult", constant, value, constant)) return binary; // Overflow: leave it to run time
+    }
+
+    if (factors.empty()) return replace(binary, makeNumber(constant));
+
+    if (constant == 0) {
+        for (const auto& factor : factors) {
+            if (canTrap(*factor.slot)) return binary;
+        }
+        return replace(binary, makeNumber(0));
+    }
+
+    bool rebuild = restructured || constants.size() > 1 || (constants.size() == 1 && constant == 1);
+    if (!rebuild) return binary;
+
+    ExpressionNode* result = nullptr;
+    for (auto& factor : factors) {
+        ExpressionNode* term = take(*factor.slot);
+        result = result ? new BinaryOpNode(result, "mult", term) : term;
+    }
+    if (constant == -1) result = new UnaryOpNode("neg", result);
+    else if (constant != 1) result = new BinaryOpNode(result, "mult", makeNumber(constant));
+
+    return replace(binary, result);
+}
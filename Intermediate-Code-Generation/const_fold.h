@@ -0,0 +1,66 @@
+#ifndef CONST_FOLD_H
+#define CONST_FOLD_H
+
+#include <string>
+#include <vector>
+#include "../ast.h"
+
+// SPL numbers are integers; folding only produces values in this range so the
+// generated BASIC holds exactly what the program would have computed at run time.
+const long long SPL_INT_MIN = -2147483647LL - 1;
+const long long SPL_INT_MAX = 2147483647LL;
+
+// Evaluates "a op b" for an SPL operator (plus, minus, mult, div, eq, >, and, or).
+// Booleans are 1 (true) / 0 (false). Returns false if the result overflows or the
+// operation has no exact integer result (division by zero or with a remainder).
+bool evalSplBinary(const std::string& op, long long a, long long b, long long& result);
+
+// The same for the BASIC operators in generated code (+ - * / = <> > < >= <= AND OR).
+// Comparisons yield BASIC truth values: -1 (true) / 0 (false); AND/OR are bitwise.
+bool evalBasicBinary(const std::string& op, long long a, long long b, long long& result);
+
+// Reads the value of a NumberNode (folded numbers may be negative).
+bool constantValue(const ExpressionNode* expr, long long& value);
+
+/**
+ * @brief Constant folding and algebraic simplification on the checked AST.
+ * Runs after type checking and before code generation, rewriting expressions in
+ * place: constant subterms are evaluated, identities such as (x plus 0),
+ * (x mult 1) and (neg (neg x)) are removed, and constants in plus/minus and mult
+ * chains are reassociated into a single literal. Branches whose condition folds
+ * to a known boolean are replaced by the arm that is taken.
+ */
+class ConstantFolder {
+public:
+    void fold(ProgramNode* program);
+    // Folds one statement list on its own, e.g. a specialised copy of a body
+    void foldStatements(AstNodeList<StatementNode>* stmts) { foldStatementList(stmts); }
+    int getFoldCount() const { return foldCount; }
+
+private:
+    int foldCount = 0;
+
+    // A term of a flattened plus/minus or mult chain; slot is the child
+    // pointer inside the original tree that owns it.
+    struct ChainTerm {
+        ExpressionNode** slot;
+        bool negated;
+    };
+
+    void foldStatementList(AstNodeList<StatementNode>* stmts);
+
+    // Takes ownership of expr and returns its (possibly new) replacement.
+    ExpressionNode* foldExpression(ExpressionNode* expr);
+    ExpressionNode* foldUnary(UnaryOpNode* unary);
+    ExpressionNode* foldBinary(BinaryOpNode* binary);
+    ExpressionNode* foldSum(BinaryOpNode* binary);
+    ExpressionNode* foldProduct(BinaryOpNode* binary);
+    ExpressionNode* replace(ExpressionNode* oldExpr, ExpressionNode* newExpr);
+
+    void collectSum(ExpressionNode** slot, bool negated, std::vector<ChainTerm>& terms,
+                    std::vector<long long>& constants, bool& restructured);
+    void collectProduct(ExpressionNode** slot, std::vector<ChainTerm>& factors,
+                        std::vector<long long>& constants, bool& restructured);
+};
+
+#endif // CONST_FOLD_H
@@ -0,0 +1,87 @@
+#include "optimizer.h"
+
+/**
+ * @brief Liveness-based dead code elimination.
+ * First deletes every block that cannot be reached from the start of the program
+ * (code after a GOTO or STOP that no jump targets). Then walks each block
+ * backwards from its live-out set and deletes assignments whose variable is not
+ * read before it is overwritten or the program ends. This catches unused
+ * temporaries, the zero temporaries of conditions, stores to locals nobody reads
+ * and return copies into unused temps. Deleting a store can make the stores
+ * feeding it dead, so the second step repeats until nothing changes.
+ */
+bool Optimizer::eliminateDeadCode() {
+    bool changed = false;
+
+    // --- Unreachable code ---
+    ControlFlowGraph cfg;
+    cfg.build(program);
+    if (cfg.blocks.empty()) return false;
+
+    std::vector<char> reached(cfg.blocks.size(), 0);
+    std::vector<int> stack = {0};
+    reached[0] = 1;
+    while (!stack.empty()) {
+        int b = stack.back();
+        stack.pop_back();
+        for (int succ : cfg.blocks[b].succs) {
+            if (!reached[succ]) {
+                reached[succ] = 1;
+                stack.push_back(succ);
+            }
+        }
+    }
+
+    std::vector<bool> deleted(program.size(), false);
+    bool anyUnreachable = false;
+    for (size_t b = 0; b < cfg.blocks.size(); ++b) {
+        if (reached[b]) continue;
+        for (size_t i = cfg.blocks[b].first; i < cfg.blocks[b].last; ++i) {
+            deleted[i] = true;
+            ++stats.unreachableRemoved;
+        }
+        anyUnreachable = true;
+    }
+    if (anyUnreachable) {
+        removeDeleted(deleted);
+        changed = true;
+    }
+
+    // --- Dead stores ---
+    bool removedStore = true;
+    while (removedStore) {
+        removedStore = false;
+        cfg.build(program);
+        VariableIndex vars;
+        Liveness liveness;
+        liveness.compute(program, cfg, vars);
+
+        deleted.assign(program.size(), false);
+        std::vector<char> live(vars.names.size(), 0);
+        for (size_t b = 0; b < cfg.blocks.size(); ++b) {
+            std::fill(live.begin(), live.end(), 0);
+            for (int v : liveness.liveOut[b]) live[v] = 1;
+
+            for (size_t i = cfg.blocks[b].last; i-- > cfg.blocks[b].first;) {
+                const Instr& instr = program[i];
+                if (instr.kind == Instr::ASSIGN) {
+                    int dst = vars.id(instr.dst);
+                    bool selfCopy = instr.op.empty() && instr.a == instr.dst;
+                    if ((!live[dst] || selfCopy) && !mayTrap(instr)) {
+                        deleted[i] = true;
+                        removedStore = true;
+                        ++stats.deadStoresRemoved;
+                        continue;
+                    }
+                    live[dst] = 0;
+                }
+                for (const auto& name : instrUses(instr)) live[vars.id(name)] = 1;
+            }
+        }
+        if (removedStore) {
+            removeDeleted(deleted);
+            changed = true;
+        }
+    }
+    return changed;
+}
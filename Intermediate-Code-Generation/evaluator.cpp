@@ -0,0 +1,301 @@
+#include "evaluator.h"
+#include "const_fold.h"
+
+// Statements executed and conditions tested before evaluation gives up
+static const long long EVAL_MAX_STEPS = 1000000;
+// Lines printed: each one becomes a PRINT in the generated code
+static const size_t EVAL_MAX_OUTPUT = 1000;
+// Calls nested inside one another
+static const int EVAL_MAX_DEPTH = 64;
+
+// The BASIC operator CodeGen generates for an SPL operator, "" if there is none
+static std::string basicOperator(const std::string& op) {
+    if (op == "plus") return "+";
+    if (op == "minus") return "-";
+    if (op == "mult") return "*";
+    if (op == "div") return "/";
+    if (op == "eq") return "=";
+    if (op == "ne") return "<>";
+    if (op == "gt" || op == ">") return ">";
+    if (op == "lt" || op == "<") return "<";
+    if (op == "ge") return ">=";
+    if (op == "le") return "<=";
+    if (op == "and") return "AND";
+    if (op == "or") return "OR";
+    return "";
+}
+
+// =================== PUBLIC ===================
+
+bool Evaluator::evaluate(ProgramNode* program) {
+    this->program = program;
+    complete = false;
+    halted = false;
+    evaluated = 0;
+    output.clear();
+    variables.clear();
+    steps = 0;
+    depth = 0;
+
+    if (!program || !program->main) return false;
+
+    Frame frame;
+    if (program->main->statements) {
+        for (auto* stmt : program->main->statements->elements) {
+            // A statement that fails leaves no trace: its output and the values
+            // it assigned before failing are dropped together
+            size_t printed = output.size();
+            std::map<std::string, long long> before = frame.vars;
+            Outcome outcome = runStatement(stmt, frame);
+            if (outcome == FAILED) {
+                output.resize(printed);
+                variables = before;
+                return false;
+            }
+            ++evaluated;
+            if (outcome == HALTED) {
+                halted = true;
+                break;
+            }
+        }
+    }
+    complete = true;
+    variables = frame.vars;
+    return true;
+}
+
+// =================== PRIVATE ===================
+
+bool Evaluator::step() {
+    return ++steps <= EVAL_MAX_STEPS;
+}
+
+Evaluator::Outcome Evaluator::runStatements(AstNodeList<StatementNode>* stmts, Frame& frame) {
+    if (!stmts) return DONE;
+    for (auto* stmt : stmts->elements) {
+        Outcome outcome = runStatement(stmt, frame);
+        if (outcome != DONE) return outcome;
+    }
+    return DONE;
+}
+
+Evaluator::Outcome Evaluator::runStatement(StatementNode* stmt, Frame& frame) {
+    if (!stmt) return DONE;
+    if (!step()) return FAILED;
+
+    if (dynamic_cast<HaltNode*>(stmt)) return HALTED;
+
+    if (auto* print = dynamic_cast<PrintNode*>(stmt)) {
+        std::string text;
+        if (auto* str = dynamic_cast<StringNode*>(print->expression)) {
+            text = "\"" + str->value + "\"";
+        } else {
+            long long value;
+            Outcome outcome = evalExpression(print->expression, frame, value);
+            if (outcome != DONE) return outcome;
+            text = std::to_string(value);
+        }
+        if (output.size() >= EVAL_MAX_OUTPUT) return FAILED;
+        output.push_back(text);
+        return DONE;
+    }
+
+    if (auto* assign = dynamic_cast<AssignNode*>(stmt)) {
+        long long value;
+        Outcome outcome = evalExpression(assign->expression, frame, value);
+        if (outcome != DONE) return outcome;
+        frame.vars[assign->var->name] = value;
+        return DONE;
+    }
+
+    if (auto* procCall = dynamic_cast<ProcCallNode*>(stmt)) {
+        Frame callee;
+        return call(procCall->name, procCall->args, frame, callee);
+    }
+
+    if (auto* ifNode = dynamic_cast<IfNode*>(stmt)) {
+        bool taken;
+        Outcome outcome = evalCondition(ifNode->condition, frame, taken);
+        if (outcome != DONE) return outcome;
+        return taken ? runStatements(ifNode->then_branch, frame) : DONE;
+    }
+
+    if (auto* ifElse = dynamic_cast<IfElseNode*>(stmt)) {
+        bool taken;
+        Outcome outcome = evalCondition(ifElse->condition, frame, taken);
+        if (outcome != DONE) return outcome;
+        return runStatements(taken ? ifElse->then_branch : ifElse->else_branch, frame);
+    }
+
+    if (auto* whileNode = dynamic_cast<WhileNode*>(stmt)) {
+        while (true) {
+            bool taken;
+            Outcome outcome = evalCondition(whileNode->condition, frame, taken);
+            if (outcome != DONE || !taken) return outcome;
+            outcome = runStatements(whileNode->body, frame);
+            if (outcome != DONE) return outcome;
+            if (!step()) return FAILED;
+        }
+    }
+
+    if (auto* doUntil = dynamic_cast<DoUntilNode*>(stmt)) {
+        while (true) {
+            Outcome outcome = runStatements(doUntil->body, frame);
+            if (outcome != DONE) return outcome;
+            bool finished;
+            outcome = evalCondition(doUntil->condition, frame, finished);
+            if (outcome != DONE || finished) return outcome;
+            if (!step()) return FAILED;
+        }
+    }
+
+    if (auto* ret = dynamic_cast<ReturnNode*>(stmt)) {
+        // Like the LET CodeGen generates for it, a return sets the result and
+        // execution carries on with the next statement
+        long long value;
+        Outcome outcome = evalExpression(ret->expression, frame, value);
+        if (outcome != DONE) return outcome;
+        frame.returned = true;
+        frame.result = value;
+        return DONE;
+    }
+
+    return FAILED;
+}
+
+Evaluator::Outcome Evaluator::evalExpression(ExpressionNode* expr, Frame& frame, long long& value) {
+    if (auto* number = dynamic_cast<NumberNode*>(expr)) {
+        return constantValue(number, value) ? DONE : FAILED;
+    }
+
+    if (auto* var = dynamic_cast<VarNode*>(expr)) {
+        auto it = frame.vars.find(var->name);
+        if (it == frame.vars.end()) return FAILED; // Read before it is assigned
+        value = it->second;
+        return DONE;
+    }
+
+    if (auto* boolNode = dynamic_cast<BoolNode*>(expr)) {
+        value = boolNode->value ? -1 : 0;
+        return DONE;
+    }
+
+    if (auto* unary = dynamic_cast<UnaryOpNode*>(expr)) {
+        long long operand;
+        Outcome outcome = evalExpression(unary->operand, frame, operand);
+        if (outcome != DONE) return outcome;
+        if (unary->op == "neg") return evalBasicBinary("-", 0, operand, value) ? DONE : FAILED;
+        if (unary->op == "not") {
+            value = (operand == 0) ? -1 : 0;
+            return DONE;
+        }
+        return FAILED;
+    }
+
+    if (auto* binary = dynamic_cast<BinaryOpNode*>(expr)) {
+        // Outside a condition both operands are evaluated, AND/OR included
+        std::string op = basicOperator(binary->op);
+        if (op.empty()) return FAILED;
+        long long left, right;
+        Outcome outcome = evalExpression(binary->left, frame, left);
+        if (outcome != DONE) return outcome;
+        outcome = evalExpression(binary->right, frame, right);
+        if (outcome != DONE) return outcome;
+        return evalBasicBinary(op, left, right, value) ? DONE : FAILED;
+    }
+
+    if (auto* funcCall = dynamic_cast<FuncCallNode*>(expr)) {
+        Frame callee;
+        Outcome outcome = call(funcCall->name, funcCall->args, frame, callee);
+        if (outcome != DONE) return outcome;
+        if (!callee.returned) return FAILED;
+        value = callee.result;
+        return DONE;
+    }
+
+    return FAILED;
+}
+
+Evaluator::Outcome Evaluator::evalCondition(ExpressionNode* expr, Frame& frame, bool& value) {
+    if (!step()) return FAILED;
+
+    if (auto* boolNode = dynamic_cast<BoolNode*>(expr)) {
+        value = boolNode->value;
+        return DONE;
+    }
+
+    if (auto* binary = dynamic_cast<BinaryOpNode*>(expr)) {
+        // AND/OR short-circuit, as in CodeGen::genCondition
+        if (binary->op == "and" || binary->op == "or") {
+            Outcome outcome = evalCondition(binary->left, frame, value);
+            if (outcome != DONE || value == (binary->op == "or")) return outcome;
+            return evalCondition(binary->right, frame, value);
+        }
+        std::string op = basicOperator(binary->op);
+        if (op.empty()) return FAILED;
+        long long left, right, result;
+        Outcome outcome = evalExpression(binary->left, frame, left);
+        if (outcome != DONE) return outcome;
+        outcome = evalExpression(binary->right, frame, right);
+        if (outcome != DONE) return outcome;
+        if (!evalBasicBinary(op, left, right, result)) return FAILED;
+        value = result != 0;
+        return DONE;
+    }
+
+    if (auto* unary = dynamic_cast<UnaryOpNode*>(expr)) {
+        if (unary->op == "not") {
+            Outcome outcome = evalCondition(unary->operand, frame, value);
+            value = !value;
+            return outcome;
+        }
+    }
+
+    long long result;
+    Outcome outcome = evalExpression(expr, frame, result);
+    value = result != 0;
+    return outcome;
+}
+
+/**
+ * Runs the body of a procedure or function in the frame callee. As in the
+ * inlined code, the body sees only its parameters: locals, and any other
+ * name it uses, start out unassigned.
+ */
+Evaluator::Outcome Evaluator::call(const std::string& name, AstNodeList<ExpressionNode>* args, Frame& frame, Frame& callee) {
+    AstNodeList<VarNode>* params = nullptr;
+    BodyNode* body = nullptr;
+    // Functions win over procedures of the same name, as in CodeGen::performInlining
+    if (program->funcs) {
+        for (auto* func : program->funcs->elements) {
+            if (func->name == name) { params = func->params; body = func->body; }
+        }
+    }
+    if (!body && program->procs) {
+        for (auto* proc : program->procs->elements) {
+            if (proc->name == name) { params = proc->params; body = proc->body; }
+        }
+    }
+    if (!body) return FAILED;
+
+    std::vector<long long> values;
+    if (args) {
+        for (auto* arg : args->elements) {
+            long long value;
+            Outcome outcome = evalExpression(arg, frame, value);
+            if (outcome != DONE) return outcome;
+            values.push_back(value);
+        }
+    }
+    if (params) {
+        for (size_t i = 0; i < params->elements.size() && i < values.size(); ++i) {
+            callee.vars[params->elements[i]->name] = values[i];
+        }
+    }
+
+    if (depth >= EVAL_MAX_DEPTH) return FAILED;
+    ++depth;
+    Outcome outcome = runStatements(body->statements, callee);
+    --depth;
+    return outcome;
+}
@@ -0,0 +1,63 @@
+#ifndef EVALUATOR_H
+#define EVALUATOR_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include "../ast.h"
+
+/**
+ * @brief Compile-time evaluation of the whole program.
+ * SPL programs read no input, so main prints the same thing on every run.
+ * The Evaluator interprets the checked AST with the semantics of the code
+ * CodeGen generates for it (BASIC truth values, inlined calls with their own
+ * variables) and records what main prints. It gives up on anything it cannot
+ * decide exactly: a variable read before it is assigned, an overflow, a
+ * division without an exact result, more than EVAL_MAX_STEPS steps, more than
+ * EVAL_MAX_OUTPUT lines printed or calls nested deeper than EVAL_MAX_DEPTH.
+ * What is kept is then the prefix of main's statements that did complete,
+ * together with the values they left in main's variables.
+ */
+class Evaluator {
+public:
+    // Returns true if the whole program was evaluated
+    bool evaluate(ProgramNode* program);
+
+    bool isComplete() const { return complete; }
+    bool hasHalted() const { return halted; }
+    // Top-level statements of main evaluated completely
+    size_t getEvaluatedCount() const { return evaluated; }
+    // Operands of the PRINTs executed by those statements, as BASIC literals
+    const std::vector<std::string>& getOutput() const { return output; }
+    // Main's variables assigned by those statements, with their values
+    const std::map<std::string, long long>& getVariables() const { return variables; }
+    long long getStepCount() const { return steps; }
+
+private:
+    enum Outcome { DONE, HALTED, FAILED };
+
+    // Variables of main or of one inlined call
+    struct Frame {
+        std::map<std::string, long long> vars;
+        bool returned = false;
+        long long result = 0;
+    };
+
+    ProgramNode* program = nullptr;
+    bool complete = false;
+    bool halted = false;
+    size_t evaluated = 0;
+    std::vector<std::string> output;
+    std::map<std::string, long long> variables;
+    long long steps = 0;
+    int depth = 0;
+
+    Outcome runStatements(AstNodeList<StatementNode>* stmts, Frame& frame);
+    Outcome runStatement(StatementNode* stmt, Frame& frame);
+    Outcome evalExpression(ExpressionNode* expr, Frame& frame, long long& value);
+    Outcome evalCondition(ExpressionNode* expr, Frame& frame, bool& value);
+    Outcome call(const std::string& name, AstNodeList<ExpressionNode>* args, Frame& frame, Frame& callee);
+    bool step();
+};
+
+#endif // EVALUATOR_H
@@ -0,0 +1,331 @@
+#include "optimizer.h"
+#include "const_fold.h"
+#include <algorithm>
+
+// A phi at the top of a block: dst takes args[k] when control arrives from
+// the k-th predecessor. Block 0 has one extra argument, for the program start.
+struct Phi {
+    int var = -1;
+    std::string dst;
+    std::vector<std::string> args;
+    bool removed = false;
+};
+
+static bool isCommutative(const std::string& op) {
+    return op == "+" || op == "*" || op == "=" || op == "<>" || op == "AND" || op == "OR";
+}
+
+// Walks the dominator tree depth first. enter(b) runs before b's children and
+// leave(b) after them, so scoped state can be pushed and popped.
+template <typename Enter, typename Leave>
+static void walkDominatorTree(const DominatorTree& dom, Enter enter, Leave leave) {
+    std::vector<std::pair<int, bool>> stack = {{0, false}};
+    while (!stack.empty()) {
+        int b = stack.back().first;
+        if (stack.back().second) {
+            stack.pop_back();
+            leave(b);
+            continue;
+        }
+        stack.back().second = true;
+        enter(b);
+        for (auto it = dom.children[b].rbegin(); it != dom.children[b].rend(); ++it) {
+            stack.push_back({*it, false});
+        }
+    }
+}
+
+/**
+ * @brief Global value numbering on SSA form.
+ * Builds pruned SSA (phis at the iterated dominance frontier of each
+ * assignment, only where the variable is live), then walks the dominator tree
+ * keeping a scoped table of the expressions computed on the way down
+ * (Briggs, Cooper and Simpson's dominator-based value numbering). An
+ * assignment whose expression is already available, or a copy, is deleted and
+ * its uses read the earlier value instead; a phi whose arguments all carry one
+ * value is deleted the same way. To leave SSA, the remaining phis become
+ * parallel copies on their incoming edges (those of an IF's jump go before
+ * the IF, or into a block of their own at the end of the program if the jump
+ * goes back to a block dominating it). Every version keeps its own name here;
+ * coalesceVariables() merges them back afterwards.
+ */
+bool Optimizer::numberValues() {
+    ControlFlowGraph cfg;
+    cfg.build(program);
+    size_t blockCount = cfg.blocks.size();
+    if (blockCount == 0) return false;
+
+    DominatorTree dom;
+    dom.build(cfg);
+    for (size_t b = 0; b < blockCount; ++b) {
+        // Unreachable code is gone once eliminateDeadCode() has run, and an IF
+        // whose jump and fall-through meet needs no edge copies of its own
+        if (!dom.reachable(b)) return false;
+        const std::vector<int>& succs = cfg.blocks[b].succs;
+        if (succs.size() == 2 && succs[0] == succs[1]) return false;
+    }
+
+    VariableIndex vars;
+    Liveness liveness;
+    liveness.compute(program, cfg, vars);
+    size_t varCount = vars.names.size();
+
+    // --- Phi placement ---
+    std::vector<std::vector<int>> defBlocks(varCount);
+    for (size_t b = 0; b < blockCount; ++b) {
+        for (size_t i = cfg.blocks[b].first; i < cfg.blocks[b].last; ++i) {
+            if (program[i].kind != Instr::ASSIGN) continue;
+            std::vector<int>& blocks = defBlocks[vars.id(program[i].dst)];
+            if (blocks.empty() || blocks.back() != static_cast<int>(b)) blocks.push_back(static_cast<int>(b));
+        }
+    }
+
+    std::vector<std::vector<int>> frontiers = dom.frontiers(cfg);
+    std::vector<std::vector<Phi>> phis(blockCount);
+    std::vector<int> hasPhi(blockCount, -1);
+    for (size_t v = 0; v < varCount; ++v) {
+        std::vector<int> worklist = defBlocks[v];
+        while (!worklist.empty()) {
+            int b = worklist.back();
+            worklist.pop_back();
+            for (int join : frontiers[b]) {
+                if (hasPhi[join] == static_cast<int>(v)) continue;
+                hasPhi[join] = static_cast<int>(v);
+                const std::vector<int>& live = liveness.liveIn[join];
+                if (!std::binary_search(live.begin(), live.end(), static_cast<int>(v))) continue;
+
+                Phi phi;
+                phi.var = static_cast<int>(v);
+                phi.args.resize(cfg.blocks[join].preds.size() + (join == 0 ? 1 : 0));
+                if (join == 0) phi.args.back() = vars.names[v];
+                phis[join].push_back(phi);
+                worklist.push_back(join);
+            }
+        }
+    }
+
+    // --- Renaming ---
+    // A variable read before it is assigned keeps its name for that initial
+    // value. Otherwise its first version takes the name, and later ones are temps.
+    std::vector<std::vector<std::string>> versions(varCount);
+    std::vector<char> nameTaken(varCount, 0);
+    for (size_t v = 0; v < varCount; ++v) versions[v].push_back(vars.names[v]);
+    for (int v : liveness.liveIn[0]) nameTaken[v] = 1;
+
+    std::vector<int> pushed; // Variables given a version, innermost last
+    std::vector<size_t> pushedMark(blockCount, 0);
+    auto define = [&](int v) {
+        std::string name = nameTaken[v] ? newTemp() : vars.names[v];
+        nameTaken[v] = 1;
+        versions[v].push_back(name);
+        pushed.push_back(v);
+        return name;
+    };
+    auto current = [&](std::string& operand) {
+        if (isVariable(operand)) operand = versions[vars.id(operand)].back();
+    };
+
+    walkDominatorTree(dom,
+        [&](int b) {
+            pushedMark[b] = pushed.size();
+            for (Phi& phi : phis[b]) phi.dst = define(phi.var);
+            for (size_t i = cfg.blocks[b].first; i < cfg.blocks[b].last; ++i) {
+                Instr& instr = program[i];
+                if (instr.kind != Instr::ASSIGN && instr.kind != Instr::PRINT && instr.kind != Instr::IF) continue;
+                current(instr.a);
+                current(instr.b);
+                if (instr.kind == Instr::ASSIGN) instr.dst = define(vars.id(instr.dst));
+            }
+            for (int succ : cfg.blocks[b].succs) {
+                const std::vector<int>& preds = cfg.blocks[succ].preds;
+                size_t k = std::find(preds.begin(), preds.end(), b) - preds.begin();
+                for (Phi& phi : phis[succ]) phi.args[k] = versions[phi.var].back();
+            }
+        },
+        [&](int b) {
+            while (pushed.size() > pushedMark[b]) {
+                versions[pushed.back()].pop_back();
+                pushed.pop_back();
+            }
+        });
+
+    // --- Value numbering ---
+    std::unordered_map<std::string, std::string> leader;    // SSA name -> name or literal holding its value
+    std::unordered_map<std::string, std::string> available; // Expression -> name holding it
+    std::vector<std::string> scope;                         // Keys added to available, innermost last
+    std::vector<size_t> scopeMark(blockCount, 0);
+    std::vector<bool> deleted(program.size(), false);
+
+    auto valueOf = [&](const std::string& operand) {
+        if (!isVariable(operand)) return operand;
+        auto it = leader.find(operand);
+        return it == leader.end() ? operand : it->second;
+    };
+    auto lookup = [&](const std::string& key, const std::string& name) {
+        auto it = available.find(key);
+        if (it != available.end()) return it->second;
+        available[key] = name;
+        scope.push_back(key);
+        return name;
+    };
+
+    walkDominatorTree(dom,
+        [&](int b) {
+            scopeMark[b] = scope.size();
+            for (Phi& phi : phis[b]) {
+                // Arguments from back edges not numbered yet are taken as they are
+                std::string same;
+                bool meaningless = true;
+                std::string key = "phi " + std::to_string(b);
+                for (const std::string& arg : phi.args) {
+                    std::string value = valueOf(arg);
+                    key += " " + value;
+                    if (value == phi.dst) continue;
+                    if (same.empty()) same = value;
+                    else if (value != same) meaningless = false;
+                }
+                if (meaningless && !same.empty()) {
+                    leader[phi.dst] = same;
+                    phi.removed = true;
+                    continue;
+                }
+                std::string found = lookup(key, phi.dst);
+                if (found != phi.dst) {
+                    leader[phi.dst] = found;
+                    phi.removed = true;
+                }
+            }
+
+            for (size_t i = cfg.blocks[b].first; i < cfg.blocks[b].last; ++i) {
+                Instr& instr = program[i];
+                if (instr.kind != Instr::ASSIGN && instr.kind != Instr::PRINT && instr.kind != Instr::IF) continue;
+                instr.a = valueOf(instr.a);
+                instr.b = valueOf(instr.b);
+                if (instr.kind != Instr::ASSIGN) continue;
+
+                if (instr.op.empty()) {
+                    leader[instr.dst] = instr.a;
+                    deleted[i] = true;
+                    continue;
+                }
+
+                long long a, b, value;
+                bool folded = false;
+                if (instr.b.empty() && literalValue(instr.a, a)) {
+                    if (a != SPL_INT_MIN) {
+                        value = -a;
+                        folded = true;
+                    } else {
+                        // "-" followed by a negative literal would not parse back
+                        instr.b = instr.a;
+                        instr.a = "0";
+                    }
+                }
+                else if (literalValue(instr.a, a) && literalValue(instr.b, b)) {
+                    folded = evalBasicBinary(instr.op, a, b, value);
+                }
+                if (folded) {
+                    leader[instr.dst] = std::to_string(value);
+                    deleted[i] = true;
+                    continue;
+                }
+
+                std::string left = instr.a, right = instr.b;
+                if (isCommutative(instr.op) && right < left) std::swap(left, right);
+                std::string found = lookup(instr.op + " " + left + " " + right, instr.dst);
+                if (found != instr.dst) {
+                    leader[instr.dst] = found;
+                    deleted[i] = true;
+                    ++stats.redundantRemoved;
+                }
+            }
+        },
+        [&](int b) {
+            while (scope.size() > scopeMark[b]) {
+                available.erase(scope.back());
+                scope.pop_back();
+            }
+        });
+
+    // --- Out of SSA ---
+    // The copies for the edge from the k-th predecessor into block b, ordered
+    // so no copy overwrites a value another one still has to read.
+    auto edgeCopies = [&](int b, size_t k, std::vector<Instr>& out) {
+        std::vector<std::pair<std::string, std::string>> moves;
+        for (const Phi& phi : phis[b]) {
+            std::string src = valueOf(phi.args[k]);
+            if (!phi.removed && src != phi.dst) moves.push_back({phi.dst, src});
+        }
+        while (!moves.empty()) {
+            bool emitted = false;
+            for (size_t m = 0; m < moves.size() && !emitted; ++m) {
+                bool stillRead = false;
+                for (size_t n = 0; n < moves.size(); ++n) {
+                    if (n != m && moves[n].second == moves[m].first) stillRead = true;
+                }
+                if (stillRead) continue;
+                out.push_back(makeCopy(moves[m].first, moves[m].second));
+                moves.erase(moves.begin() + m);
+                emitted = true;
+            }
+            if (emitted) continue;
+            // Only cycles are left: save one destination and read the copy instead
+            std::string saved = newTemp();
+            std::string dst = moves[0].first;
+            out.push_back(makeCopy(saved, dst));
+            for (auto& move : moves) {
+                if (move.second == dst) move.second = saved;
+            }
+        }
+    };
+    auto predIndex = [&](int b, int pred) {
+        const std::vector<int>& preds = cfg.blocks[b].preds;
+        return static_cast<size_t>(std::find(preds.begin(), preds.end(), pred) - preds.begin());
+    };
+
+    std::vector<Instr> result;
+    std::vector<Instr> edgeBlocks;
+    result.reserve(program.size());
+    if (!phis[0].empty()) edgeCopies(0, cfg.blocks[0].preds.size(), result);
+
+    for (size_t b = 0; b < blockCount; ++b) {
+        const BasicBlock& block = cfg.blocks[b];
+        Instr tail = program[block.last - 1];
+        bool jumps = tail.kind == Instr::GOTO || tail.kind == Instr::IF;
+        for (size_t i = block.first; i + 1 < block.last; ++i) {
+            if (!deleted[i]) result.push_back(program[i]);
+        }
+
+        int taken = -1, fallthrough = -1;
+        for (int succ : block.succs) {
+            auto target = cfg.labelBlock.find(tail.label);
+            if (jumps && target != cfg.labelBlock.end() && target->second == succ) taken = succ;
+            else fallthrough = succ;
+        }
+        std::vector<Instr> takenCopies, fallthroughCopies;
+        if (taken != -1) edgeCopies(taken, predIndex(taken, static_cast<int>(b)), takenCopies);
+        if (fallthrough != -1) edgeCopies(fallthrough, predIndex(fallthrough, static_cast<int>(b)), fallthroughCopies);
+
+        if (tail.kind == Instr::IF && !takenCopies.empty() && dom.dominates(taken, static_cast<int>(b))) {
+            // A jump back into the versions it writes: the copies get a block of
+            // their own. Any other jump target's versions are defined on every
+            // way into it, so they are dead on the fall-through and the
+            // copies can run before the IF (a rotated loop's entry test).
+            std::string edgeLabel = newLabel("LBL_EDGE");
+            edgeBlocks.push_back(makeLabel(edgeLabel));
+            edgeBlocks.insert(edgeBlocks.end(), takenCopies.begin(), takenCopies.end());
+            edgeBlocks.push_back(makeGoto(tail.label));
+            tail.label = edgeLabel;
+            takenCopies.clear();
+        }
+        result.insert(result.end(), takenCopies.begin(), takenCopies.end());
+
+        if (jumps) result.push_back(tail);
+        else if (!deleted[block.last - 1]) result.push_back(tail);
+        result.insert(result.end(), fallthroughCopies.begin(), fallthroughCopies.end());
+    }
+
+    appendDetached(result, edgeBlocks);
+    program = std::move(result);
+    return true;
+}
@@ -0,0 +1,193 @@
+#include "induction.h"
+#include "const_fold.h"
+#include <algorithm>
+
+// =================== Affine Values ===================
+
+long long Affine::coefficient(const std::string& var) const {
+    auto it = terms.find(var);
+    return it == terms.end() ? 0 : it->second;
+}
+
+static bool inRange(long long value) {
+    return value >= SPL_INT_MIN && value <= SPL_INT_MAX;
+}
+
+static Affine unknown() {
+    Affine value;
+    value.known = false;
+    return value;
+}
+
+static Affine operandValue(const std::string& operand, const AffineState& state) {
+    Affine value;
+    if (literalValue(operand, value.constant)) return value;
+    if (!isVariable(operand)) return unknown();
+    auto it = state.find(operand);
+    if (it != state.end()) return it->second;
+    value.terms[operand] = 1;
+    return value;
+}
+
+// x + factor * y
+static Affine addScaled(const Affine& x, const Affine& y, long long factor) {
+    if (!x.known || !y.known) return unknown();
+    Affine sum = x;
+    sum.constant += factor * y.constant;
+    if (!inRange(sum.constant)) return unknown();
+    for (const auto& term : y.terms) {
+        long long& coefficient = sum.terms[term.first];
+        coefficient += factor * term.second;
+        if (!inRange(coefficient)) return unknown();
+        if (coefficient == 0) sum.terms.erase(term.first);
+    }
+    return sum;
+}
+
+static Affine scale(const Affine& x, long long factor) {
+    Affine zero;
+    return addScaled(zero, x, factor);
+}
+
+void runAffine(const std::vector<Instr>& code, const std::vector<size_t>& instrs, AffineState& state) {
+    for (size_t i : instrs) {
+        const Instr& instr = code[i];
+        if (instr.kind != Instr::ASSIGN) continue;
+
+        Affine a = operandValue(instr.a, state);
+        Affine result;
+        if (instr.op.empty()) {
+            result = a;
+        }
+        else if (instr.b.empty()) {
+            result = scale(a, -1);
+        }
+        else {
+            Affine b = operandValue(instr.b, state);
+            if (instr.op == "+") result = addScaled(a, b, 1);
+            else if (instr.op == "-") result = addScaled(a, b, -1);
+            else if (instr.op == "*" && a.known && a.isConstant()) result = scale(b, a.constant);
+            else if (instr.op == "*" && b.known && b.isConstant()) result = scale(a, b.constant);
+            else result = unknown();
+        }
+        state[instr.dst] = result;
+    }
+}
+
+// =================== Counted Loops ===================
+
+bool analyzeCountedLoop(const std::vector<Instr>& code, const ControlFlowGraph& cfg, const Loop& loop,
+                        CountedLoop& result) {
+    result = CountedLoop();
+    result.loop = loop;
+    if (loop.latches.size() != 1) return false;
+
+    // Follow the path from the header: one successor in the loop per block
+    std::vector<int> path;
+    int exiting = -1;
+    int b = loop.header;
+    do {
+        path.push_back(b);
+        if (path.size() > loop.blocks.size()) return false;
+        int inside = -1;
+        for (int succ : cfg.blocks[b].succs) {
+            if (loop.contains(succ)) {
+                if (inside != -1) return false;
+                inside = succ;
+            } else {
+                if (exiting != -1) return false;
+                exiting = b;
+                result.exitBlock = succ;
+            }
+        }
+        if (inside == -1) return false;
+        b = inside;
+    } while (b != loop.header);
+    if (path.size() != loop.blocks.size() || exiting == -1) return false;
+
+    // Split the path at the test
+    const BasicBlock& exitingBlock = cfg.blocks[exiting];
+    result.test = exitingBlock.last - 1;
+    if (code[result.test].kind != Instr::IF) return false;
+
+    std::vector<size_t> rest;
+    bool afterTest = false;
+    for (int pb : path) {
+        for (size_t i = cfg.blocks[pb].first; i < cfg.blocks[pb].last; ++i) {
+            const Instr& instr = code[i];
+            if (i == result.test) {
+                afterTest = true;
+            } else if (instr.kind == Instr::ASSIGN || instr.kind == Instr::PRINT) {
+                (afterTest ? rest : result.entry).push_back(i);
+            } else if (instr.kind == Instr::IF || instr.kind == Instr::OTHER) {
+                return false;
+            }
+        }
+    }
+    result.trip = rest;
+    result.trip.insert(result.trip.end(), result.entry.begin(), result.entry.end());
+    runAffine(code, result.trip, result.tripEffect);
+
+    // The test, as the condition for staying in the loop
+    const Instr& test = code[result.test];
+    bool stayOnJump = loop.contains(exitingBlock.succs[0]);
+    std::string cmp = stayOnJump ? test.op : invertComparison(test.op);
+    std::string left = test.a, right = test.b;
+    auto assigned = [&](const std::string& operand) {
+        return result.tripEffect.count(operand) > 0;
+    };
+    if (assigned(right) && !assigned(left)) {
+        std::swap(left, right);
+        cmp = mirrorComparison(cmp);
+    }
+    if (!isVariable(left) || !assigned(left) || assigned(right) || cmp == "=") return false;
+    result.counter = left;
+    result.bound = right;
+    result.cmp = cmp;
+
+    // The counter must move by the same constant every trip
+    const Affine& effect = result.tripEffect[left];
+    if (!effect.known || effect.terms.size() != 1 || effect.coefficient(left) != 1 || effect.constant == 0) {
+        return false;
+    }
+    result.step = effect.constant;
+    return true;
+}
+
+static long long ceilDiv(long long a, long long b) {
+    return (a + b - 1) / b; // a >= 0, b > 0
+}
+
+bool tripCount(const CountedLoop& loop, long long start, long long bound, long long& trips) {
+    long long step = loop.step;
+    const std::string& cmp = loop.cmp;
+    if (cmp == "<") {
+        if (start >= bound) trips = 0;
+        else if (step <= 0) return false;
+        else trips = ceilDiv(bound - start, step);
+    }
+    else if (cmp == "<=") {
+        if (start > bound) trips = 0;
+        else if (step <= 0) return false;
+        else trips = (bound - start) / step + 1;
+    }
+    else if (cmp == ">") {
+        if (start <= bound) trips = 0;
+        else if (step >= 0) return false;
+        else trips = ceilDiv(start - bound, -step);
+    }
+    else if (cmp == ">=") {
+        if (start < bound) trips = 0;
+        else if (step >= 0) return false;
+        else trips = (start - bound) / -step + 1;
+    }
+    else if (cmp == "<>") {
+        if (start == bound) trips = 0;
+        else if ((bound - start) % step != 0 || (bound - start) / step < 0) return false;
+        else trips = (bound - start) / step;
+    }
+    else {
+        return false;
+    }
+    return trips <= SPL_INT_MAX;
+}
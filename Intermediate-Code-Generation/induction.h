@@ -0,0 +1,59 @@
+#ifndef INDUCTION_H
+#define INDUCTION_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include "ir.h"
+
+// A linear expression over the values variables had at the start of a loop
+// trip: constant + sum of coefficient * variable. Values that are not affine
+// (a product of two variables, a division, a comparison) are unknown.
+struct Affine {
+    bool known = true;
+    long long constant = 0;
+    std::map<std::string, long long> terms;
+
+    bool isConstant() const { return terms.empty(); }
+    long long coefficient(const std::string& var) const;
+};
+
+// Variable -> its value after running some instructions, in terms of the values
+// before them. Variables that are not in the map still hold their old value.
+typedef std::map<std::string, Affine> AffineState;
+
+// Runs the assignments at the given indexes symbolically (PRINTs change
+// nothing). Coefficients outside the SPL integer range make a value unknown.
+void runAffine(const std::vector<Instr>& code, const std::vector<size_t>& instrs, AffineState& state);
+
+/**
+ * @brief A loop that runs one straight path of blocks with a single exit test.
+ * Entered at the header, it runs `entry` (the instructions from the header up
+ * to the test), then tests; while the test says stay it runs `trip` (the rest
+ * of the path back to the header, then `entry` again) and tests again. For a
+ * while loop tested at the top, entry is empty and trip is the body.
+ */
+struct CountedLoop {
+    Loop loop;
+    std::vector<size_t> entry;   // Assignments/PRINTs before the first test
+    std::vector<size_t> trip;    // Assignments/PRINTs between two tests
+    size_t test = 0;             // Index of the exit IF
+    int exitBlock = -1;          // Block the loop leaves to
+
+    // Stay in the loop while "counter cmp bound"; bound is not assigned in the loop
+    std::string counter, cmp, bound;
+    long long step = 0;          // Net change of counter per trip
+    AffineState tripEffect;      // Effect of one trip on every variable it assigns
+};
+
+// Recognises the shape above, with a counter that changes by a constant each
+// trip and moves towards the bound (or away from it, for loops that never end,
+// which callers have to reject via tripCount()).
+bool analyzeCountedLoop(const std::vector<Instr>& code, const ControlFlowGraph& cfg, const Loop& loop,
+                        CountedLoop& result);
+
+// How many trips run when the counter starts at start (its value at the first
+// test). False if the loop would not stop or the count does not fit an int.
+bool tripCount(const CountedLoop& loop, long long start, long long bound, long long& trips);
+
+#endif // INDUCTION_H
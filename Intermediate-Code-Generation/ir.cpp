@@ -0,0 +1,448 @@
+#include "ir.h"
+#include "const_fold.h"
+#include <sstream>
+#include <algorithm>
+#include <iterator>
+#include <cctype>
+
+// =================== Parsing ===================
+
+bool isLiteral(const std::string& operand) {
+    size_t start = (!operand.empty() && operand[0] == '-') ? 1 : 0;
+    if (start == operand.size()) return false;
+    for (size_t i = start; i < operand.size(); ++i) {
+        if (!std::isdigit(static_cast<unsigned char>(operand[i]))) return false;
+    }
+    return true;
+}
+
+bool isVariable(const std::string& operand) {
+    if (operand.empty() || !std::isalpha(static_cast<unsigned char>(operand[0]))) return false;
+    for (char c : operand) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_') return false;
+    }
+    return true;
+}
+
+bool literalValue(const std::string& operand, long long& value) {
+    if (!isLiteral(operand) || operand.size() > 11) return false;
+    long long v = std::stoll(operand);
+    if (v < SPL_INT_MIN || v > SPL_INT_MAX) return false;
+    value = v;
+    return true;
+}
+
+static bool isAtom(const std::string& operand) {
+    return isVariable(operand) || isLiteral(operand);
+}
+
+static bool isBinaryOperator(const std::string& op) {
+    return op == "+" || op == "-" || op == "*" || op == "/" ||
+           op == "=" || op == "<>" || op == ">" || op == "<" || op == ">=" || op == "<=" ||
+           op == "AND" || op == "OR";
+}
+
+static bool isComparison(const std::string& op) {
+    return op == "=" || op == "<>" || op == ">" || op == "<" || op == ">=" || op == "<=";
+}
+
+// Parses the right-hand side of an assignment: "a", "-a" or "(a op b)"
+static bool parseRhs(const std::string& rhs, Instr& instr) {
+    if (rhs.size() > 2 && rhs.front() == '(' && rhs.back() == ')') {
+        std::istringstream iss(rhs.substr(1, rhs.size() - 2));
+        std::string a, op, b, extra;
+        if (!(iss >> a >> op >> b) || (iss >> extra)) return false;
+        if (!isAtom(a) || !isAtom(b) || !isBinaryOperator(op)) return false;
+        instr.a = a;
+        instr.op = op;
+        instr.b = b;
+        return true;
+    }
+    if (rhs.size() > 1 && rhs[0] == '-' && isVariable(rhs.substr(1))) {
+        instr.op = "-";
+        instr.a = rhs.substr(1);
+        return true;
+    }
+    if (isAtom(rhs)) {
+        instr.a = rhs;
+        return true;
+    }
+    return false;
+}
+
+Instr parseInstr(const std::string& line) {
+    Instr instr;
+    instr.text = line;
+
+    std::istringstream iss(line);
+    std::vector<std::string> tokens;
+    std::string token;
+    while (iss >> token) tokens.push_back(token);
+    if (tokens.empty()) return instr;
+
+    if (tokens.size() == 1 && tokens[0] == "STOP") {
+        instr.kind = Instr::STOP;
+    }
+    else if (tokens.size() == 2 && tokens[0] == "REM") {
+        instr.kind = Instr::LABEL;
+        instr.label = tokens[1];
+    }
+    else if (tokens.size() == 2 && tokens[0] == "GOTO") {
+        instr.kind = Instr::GOTO;
+        instr.label = tokens[1];
+    }
+    else if (tokens.size() == 2 && tokens[0] == "PRINT") {
+        instr.kind = Instr::PRINT;
+        instr.a = tokens[1];
+    }
+    else if (tokens.size() == 6 && tokens[0] == "IF" && tokens[4] == "THEN" &&
+             isAtom(tokens[1]) && isComparison(tokens[2]) && isAtom(tokens[3])) {
+        instr.kind = Instr::IF;
+        instr.a = tokens[1];
+        instr.op = tokens[2];
+        instr.b = tokens[3];
+        instr.label = tokens[5];
+    }
+    else if (line.find("CALL_") == std::string::npos) {
+        // "LET x = rhs", or "x = rhs" as some older lowerings still emit
+        size_t nameIndex = (tokens[0] == "LET") ? 1 : 0;
+        size_t eq = line.find(" = ");
+        if (tokens.size() > nameIndex + 2 && tokens[nameIndex + 1] == "=" && isVariable(tokens[nameIndex]) &&
+            eq != std::string::npos && parseRhs(line.substr(eq + 3), instr)) {
+            instr.kind = Instr::ASSIGN;
+            instr.dst = tokens[nameIndex];
+        } else {
+            instr.a = instr.op = instr.b = "";
+        }
+    }
+    return instr;
+}
+
+std::string renderInstr(const Instr& instr) {
+    switch (instr.kind) {
+        case Instr::ASSIGN:
+            if (instr.op.empty()) return "LET " + instr.dst + " = " + instr.a;
+            if (instr.b.empty()) return "LET " + instr.dst + " = " + instr.op + instr.a;
+            return "LET " + instr.dst + " = (" + instr.a + " " + instr.op + " " + instr.b + ")";
+        case Instr::PRINT: return "PRINT " + instr.a;
+        case Instr::IF:    return "IF " + instr.a + " " + instr.op + " " + instr.b + " THEN " + instr.label;
+        case Instr::GOTO:  return "GOTO " + instr.label;
+        case Instr::LABEL: return "REM " + instr.label;
+        case Instr::STOP:  return "STOP";
+        default:           return instr.text;
+    }
+}
+
+std::string invertComparison(const std::string& op) {
+    if (op == "=") return "<>";
+    if (op == "<>") return "=";
+    if (op == ">") return "<=";
+    if (op == "<=") return ">";
+    if (op == "<") return ">=";
+    return "<";
+}
+
+std::string mirrorComparison(const std::string& op) {
+    if (op == ">") return "<";
+    if (op == "<") return ">";
+    if (op == ">=") return "<=";
+    if (op == "<=") return ">=";
+    return op;
+}
+
+Instr makeLabel(const std::string& label) {
+    Instr instr;
+    instr.kind = Instr::LABEL;
+    instr.label = label;
+    return instr;
+}
+
+Instr makeGoto(const std::string& label) {
+    Instr instr;
+    instr.kind = Instr::GOTO;
+    instr.label = label;
+    return instr;
+}
+
+Instr makeCopy(const std::string& dst, const std::string& src) {
+    Instr instr;
+    instr.kind = Instr::ASSIGN;
+    instr.dst = dst;
+    instr.a = src;
+    return instr;
+}
+
+std::vector<std::string> instrUses(const Instr& instr) {
+    std::vector<std::string> uses;
+    if (instr.kind == Instr::ASSIGN || instr.kind == Instr::PRINT || instr.kind == Instr::IF) {
+        if (isVariable(instr.a)) uses.push_back(instr.a);
+        if (isVariable(instr.b)) uses.push_back(instr.b);
+    }
+    return uses;
+}
+
+bool mayTrap(const Instr& instr) {
+    long long divisor;
+    return instr.kind == Instr::ASSIGN && instr.op == "/" && !(literalValue(instr.b, divisor) && divisor != 0);
+}
+
+// =================== Control Flow Graph ===================
+
+void ControlFlowGraph::build(const std::vector<Instr>& code) {
+    blocks.clear();
+    labelBlock.clear();
+    blockOf.assign(code.size(), -1);
+
+    // Split at labels and after jumps
+    bool startBlock = true;
+    for (size_t i = 0; i < code.size(); ++i) {
+        if (code[i].kind == Instr::LABEL || startBlock) {
+            if (!blocks.empty()) blocks.back().last = i;
+            BasicBlock block;
+            block.first = i;
+            blocks.push_back(block);
+        }
+        blockOf[i] = static_cast<int>(blocks.size()) - 1;
+        if (code[i].kind == Instr::LABEL) labelBlock[code[i].label] = blockOf[i];
+
+        Instr::Kind kind = code[i].kind;
+        startBlock = (kind == Instr::IF || kind == Instr::GOTO || kind == Instr::STOP);
+    }
+    if (!blocks.empty()) blocks.back().last = code.size();
+
+    // Edges
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        const Instr& tail = code[blocks[b].last - 1];
+        int next = (b + 1 < blocks.size()) ? static_cast<int>(b + 1) : -1;
+
+        if (tail.kind == Instr::IF || tail.kind == Instr::GOTO) {
+            auto it = labelBlock.find(tail.label);
+            if (it != labelBlock.end()) blocks[b].succs.push_back(it->second);
+        }
+        if (tail.kind != Instr::GOTO && tail.kind != Instr::STOP && next != -1) {
+            blocks[b].succs.push_back(next);
+        }
+        for (int succ : blocks[b].succs) {
+            blocks[succ].preds.push_back(static_cast<int>(b));
+        }
+    }
+}
+
+// =================== Dominators ===================
+
+void DominatorTree::build(const ControlFlowGraph& cfg) {
+    size_t blockCount = cfg.blocks.size();
+    idom.assign(blockCount, -1);
+    children.assign(blockCount, std::vector<int>());
+    order.clear();
+    rpoIndex.assign(blockCount, -1);
+    if (blockCount == 0) return;
+
+    // Postorder of a DFS from the entry
+    std::vector<char> seen(blockCount, 0);
+    std::vector<std::pair<int, size_t>> stack = {{0, 0}};
+    seen[0] = 1;
+    while (!stack.empty()) {
+        int b = stack.back().first;
+        const std::vector<int>& succs = cfg.blocks[b].succs;
+        if (stack.back().second < succs.size()) {
+            int succ = succs[stack.back().second++];
+            if (!seen[succ]) {
+                seen[succ] = 1;
+                stack.push_back({succ, 0});
+            }
+        } else {
+            order.push_back(b);
+            stack.pop_back();
+        }
+    }
+    std::reverse(order.begin(), order.end());
+    for (size_t i = 0; i < order.size(); ++i) rpoIndex[order[i]] = static_cast<int>(i);
+
+    auto intersect = [&](int a, int b) {
+        while (a != b) {
+            while (rpoIndex[a] > rpoIndex[b]) a = idom[a];
+            while (rpoIndex[b] > rpoIndex[a]) b = idom[b];
+        }
+        return a;
+    };
+
+    idom[0] = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 1; i < order.size(); ++i) {
+            int b = order[i];
+            int newIdom = -1;
+            for (int pred : cfg.blocks[b].preds) {
+                if (idom[pred] == -1) continue; // Unreachable or not processed yet
+                newIdom = (newIdom == -1) ? pred : intersect(pred, newIdom);
+            }
+            if (idom[b] != newIdom) {
+                idom[b] = newIdom;
+                changed = true;
+            }
+        }
+    }
+    idom[0] = -1;
+
+    for (size_t i = 1; i < order.size(); ++i) {
+        children[idom[order[i]]].push_back(order[i]);
+    }
+
+    enter.assign(blockCount, -1);
+    leave.assign(blockCount, -1);
+    int clock = 0;
+    std::vector<std::pair<int, size_t>> walk = {{0, 0}};
+    enter[0] = clock++;
+    while (!walk.empty()) {
+        int b = walk.back().first;
+        if (walk.back().second < children[b].size()) {
+            int child = children[b][walk.back().second++];
+            enter[child] = clock++;
+            walk.push_back({child, 0});
+        } else {
+            leave[b] = clock++;
+            walk.pop_back();
+        }
+    }
+}
+
+std::vector<std::vector<int>> DominatorTree::frontiers(const ControlFlowGraph& cfg) const {
+    std::vector<std::vector<int>> frontier(cfg.blocks.size());
+    for (int b : order) {
+        const std::vector<int>& preds = cfg.blocks[b].preds;
+        if (preds.size() + (b == 0 ? 1 : 0) < 2) continue;
+        for (int pred : preds) {
+            if (!reachable(pred)) continue;
+            for (int runner = pred; runner != idom[b]; runner = idom[runner]) {
+                if (frontier[runner].empty() || frontier[runner].back() != b) frontier[runner].push_back(b);
+                if (runner == 0) break;
+            }
+        }
+    }
+    return frontier;
+}
+
+// =================== Loops ===================
+
+bool Loop::contains(int block) const {
+    return std::binary_search(blocks.begin(), blocks.end(), block);
+}
+
+std::vector<Loop> findLoops(const ControlFlowGraph& cfg, const DominatorTree& dom) {
+    std::vector<Loop> loops;
+    std::vector<int> loopOf(cfg.blocks.size(), -1); // Header -> index in loops
+    std::vector<int> mark(cfg.blocks.size(), -1);
+
+    for (int b : dom.order) {
+        for (int succ : cfg.blocks[b].succs) {
+            if (!dom.dominates(succ, b)) continue;
+            if (loopOf[succ] == -1) {
+                loopOf[succ] = static_cast<int>(loops.size());
+                loops.push_back(Loop());
+                loops.back().header = succ;
+            }
+            loops[loopOf[succ]].latches.push_back(b);
+        }
+    }
+
+    // Walk backwards from the latches; the header stops the walk
+    for (size_t l = 0; l < loops.size(); ++l) {
+        Loop& loop = loops[l];
+        mark[loop.header] = static_cast<int>(l);
+        loop.blocks.push_back(loop.header);
+        std::vector<int> stack;
+        for (int latch : loop.latches) {
+            if (mark[latch] != static_cast<int>(l)) {
+                mark[latch] = static_cast<int>(l);
+                loop.blocks.push_back(latch);
+                stack.push_back(latch);
+            }
+        }
+        while (!stack.empty()) {
+            int b = stack.back();
+            stack.pop_back();
+            for (int pred : cfg.blocks[b].preds) {
+                if (mark[pred] == static_cast<int>(l) || !dom.reachable(pred)) continue;
+                mark[pred] = static_cast<int>(l);
+                loop.blocks.push_back(pred);
+                stack.push_back(pred);
+            }
+        }
+        std::sort(loop.blocks.begin(), loop.blocks.end());
+    }
+
+    std::stable_sort(loops.begin(), loops.end(), [](const Loop& x, const Loop& y) {
+        return x.blocks.size() < y.blocks.size();
+    });
+    return loops;
+}
+
+// =================== Liveness ===================
+
+int VariableIndex::id(const std::string& name) {
+    auto it = ids.find(name);
+    if (it != ids.end()) return it->second;
+    int newId = static_cast<int>(names.size());
+    ids[name] = newId;
+    names.push_back(name);
+    return newId;
+}
+
+int VariableIndex::find(const std::string& name) const {
+    auto it = ids.find(name);
+    return it == ids.end() ? -1 : it->second;
+}
+
+static void sortUnique(std::vector<int>& set) {
+    std::sort(set.begin(), set.end());
+    set.erase(std::unique(set.begin(), set.end()), set.end());
+}
+
+void Liveness::compute(const std::vector<Instr>& code, const ControlFlowGraph& cfg, VariableIndex& vars) {
+    size_t blockCount = cfg.blocks.size();
+    std::vector<std::vector<int>> uses(blockCount), defs(blockCount);
+
+    // Upward-exposed uses and definitions of each block
+    for (size_t b = 0; b < blockCount; ++b) {
+        std::vector<int>& use = uses[b];
+        std::vector<int>& def = defs[b];
+        for (size_t i = cfg.blocks[b].first; i < cfg.blocks[b].last; ++i) {
+            for (const auto& name : instrUses(code[i])) {
+                int v = vars.id(name);
+                if (std::find(def.begin(), def.end(), v) == def.end()) use.push_back(v);
+            }
+            if (code[i].kind == Instr::ASSIGN) def.push_back(vars.id(code[i].dst));
+        }
+        sortUnique(use);
+        sortUnique(def);
+    }
+
+    liveIn.assign(blockCount, std::vector<int>());
+    liveOut.assign(blockCount, std::vector<int>());
+    for (size_t b = 0; b < blockCount; ++b) liveIn[b] = uses[b];
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t n = blockCount; n-- > 0;) {
+            std::vector<int> out;
+            for (int succ : cfg.blocks[n].succs) {
+                out.insert(out.end(), liveIn[succ].begin(), liveIn[succ].end());
+            }
+            sortUnique(out);
+
+            std::vector<int> in;
+            std::set_difference(out.begin(), out.end(), defs[n].begin(), defs[n].end(), std::back_inserter(in));
+            in.insert(in.end(), uses[n].begin(), uses[n].end());
+            sortUnique(in);
+
+            if (in != liveIn[n]) {
+                liveIn[n] = std::move(in);
+                changed = true;
+            }
+            liveOut[n] = std::move(out);
+        }
+    }
+}
@@ -0,0 +1,114 @@
+#ifndef IR_H
+#define IR_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// One line of generated BASIC in parsed form, so the optimisation passes do not
+// have to pattern-match strings. Operands are variable names, integer literals
+// or (PRINT only) string literals.
+struct Instr {
+    enum Kind { ASSIGN, PRINT, IF, GOTO, LABEL, STOP, OTHER };
+
+    Kind kind = OTHER;
+    std::string dst;   // ASSIGN: variable written
+    std::string op;    // ASSIGN: "" (copy), "-" (negation) or a binary operator; IF: comparison
+    std::string a, b;  // Operands
+    std::string label; // IF/GOTO: jump target; LABEL: label defined by "REM <label>"
+    std::string text;  // OTHER: the line exactly as generated
+};
+
+Instr parseInstr(const std::string& line);
+std::string renderInstr(const Instr& instr);
+
+bool isLiteral(const std::string& operand);  // Integer literal (possibly negative)
+bool isVariable(const std::string& operand);
+bool literalValue(const std::string& operand, long long& value); // False if not a literal in SPL range
+
+// The comparison that holds exactly when op does not ("<" -> ">=")
+std::string invertComparison(const std::string& op);
+// The comparison with its operands swapped ("<" -> ">")
+std::string mirrorComparison(const std::string& op);
+
+Instr makeLabel(const std::string& label);
+Instr makeGoto(const std::string& label);
+Instr makeCopy(const std::string& dst, const std::string& src);
+
+// Variables read by an instruction (at most two)
+std::vector<std::string> instrUses(const Instr& instr);
+
+// True if evaluating the assignment can fail at run time, so it may be neither
+// dropped nor executed where it was not before: division by anything but a
+// nonzero literal.
+bool mayTrap(const Instr& instr);
+
+struct BasicBlock {
+    size_t first = 0;        // Index of the first instruction
+    size_t last = 0;         // One past the last instruction
+    std::vector<int> succs;  // IF: {target, fall-through}
+    std::vector<int> preds;
+};
+
+// Basic blocks of a flat instruction list. Blocks start at labels and after
+// IF/GOTO/STOP, and keep the order of the code they were built from.
+struct ControlFlowGraph {
+    std::vector<BasicBlock> blocks;
+    std::vector<int> blockOf;                          // Instruction index -> block
+    std::unordered_map<std::string, int> labelBlock;   // Label -> block it starts
+
+    void build(const std::vector<Instr>& code);
+};
+
+// Immediate dominators of the blocks reachable from block 0, computed with the
+// iterative algorithm of Cooper, Harvey and Kennedy.
+struct DominatorTree {
+    std::vector<int> idom;                  // -1 for block 0 and unreachable blocks
+    std::vector<std::vector<int>> children;
+    std::vector<int> order;                 // Reachable blocks in reverse postorder
+    std::vector<int> rpoIndex;              // Block -> position in order, -1 if unreachable
+    std::vector<int> enter, leave;          // DFS numbering of the tree, for dominates()
+
+    void build(const ControlFlowGraph& cfg);
+    bool reachable(int block) const { return rpoIndex[block] != -1; }
+    // Every path from the start of the program to b passes through a
+    bool dominates(int a, int b) const {
+        return reachable(a) && reachable(b) && enter[a] <= enter[b] && leave[b] <= leave[a];
+    }
+    // Join points each block's definitions reach. Block 0 counts as having an
+    // extra predecessor: the start of the program.
+    std::vector<std::vector<int>> frontiers(const ControlFlowGraph& cfg) const;
+};
+
+// A natural loop: the header and every block that reaches one of its back
+// edges without passing through the header. Back edges to the same header
+// form one loop.
+struct Loop {
+    int header = -1;
+    std::vector<int> blocks;   // Sorted, header included
+    std::vector<int> latches;  // Blocks with a back edge to the header
+
+    bool contains(int block) const;
+};
+
+// The natural loops of the reachable code, innermost (smallest) first
+std::vector<Loop> findLoops(const ControlFlowGraph& cfg, const DominatorTree& dom);
+
+// Dense numbering of the variables in a program, for the dataflow analyses
+struct VariableIndex {
+    std::unordered_map<std::string, int> ids;
+    std::vector<std::string> names;
+
+    int id(const std::string& name);   // Adds the variable if it is new
+    int find(const std::string& name) const; // -1 if unknown
+};
+
+// Backward liveness per block. Sets are sorted vectors of variable ids; most
+// temporaries never leave their block, so they stay small.
+struct Liveness {
+    std::vector<std::vector<int>> liveIn, liveOut;
+
+    void compute(const std::vector<Instr>& code, const ControlFlowGraph& cfg, VariableIndex& vars);
+};
+
+#endif // IR_H
@@ -0,0 +1,306 @@
+#include "optimizer.h"
+#include "induction.h"
+#include "const_fold.h"
+#include "ranges.h"
+#include <algorithm>
+
+static bool liveIn(const Liveness& liveness, const VariableIndex& vars, int block, const std::string& name) {
+    int v = vars.find(name);
+    const std::vector<int>& live = liveness.liveIn[block];
+    return v != -1 && std::binary_search(live.begin(), live.end(), v);
+}
+
+static Instr makeBinary(const std::string& dst, const std::string& a, const std::string& op, const std::string& b) {
+    Instr instr;
+    instr.kind = Instr::ASSIGN;
+    instr.dst = dst;
+    instr.a = a;
+    instr.op = op;
+    instr.b = b;
+    return instr;
+}
+
+/**
+ * @brief Induction-variable optimisation.
+ * A counting loop that does nothing but accumulate affine functions of its
+ * counter (no PRINT, nothing that may trap, every variable read after the loop
+ * is the counter or an accumulator "s = s + a*i + b") is replaced by its
+ * closed form: the trip count n is computed from the bound, and each
+ * accumulator gets a*(n*i + step*n*(n-1)/2) + b*n in one go. Only counters
+ * that move by 1 are handled. n*(n-1) is even, so halving it is exact; the
+ * value ranges on entry must show that no value the closed form computes on
+ * the way leaves the integer range.
+ * In the loops that remain, a product "d = i * k" of a basic induction
+ * variable (i = i + c, the only assignment to i in the loop) and an invariant
+ * is strength-reduced: d is set before the loop and stepped by c*k right after
+ * the increment of i.
+ */
+bool Optimizer::reduceInductionVariables() {
+    bool changedAny = false;
+    for (size_t round = 0; round < program.size(); ++round) {
+        ControlFlowGraph cfg;
+        cfg.build(program);
+        if (cfg.blocks.empty()) break;
+        DominatorTree dom;
+        dom.build(cfg);
+        std::vector<Loop> loops = findLoops(cfg, dom);
+        VariableIndex vars;
+        Liveness liveness;
+        liveness.compute(program, cfg, vars);
+        RangeAnalysis ranges;
+        ranges.compute(program, cfg);
+
+        bool changed = false;
+        for (const Loop& loop : loops) {
+            if (!hasPreheaderSlot(cfg, loop)) continue;
+            CountedLoop counted;
+            if (analyzeCountedLoop(program, cfg, loop, counted) &&
+                replaceWithClosedForm(cfg, counted, liveness, vars, ranges)) {
+                changed = true;
+                break;
+            }
+            if (reduceMultiplication(cfg, loop, liveness, vars)) {
+                changed = true;
+                break;
+            }
+        }
+        if (!changed) break;
+        changedAny = true;
+    }
+    return changedAny;
+}
+
+bool Optimizer::replaceWithClosedForm(const ControlFlowGraph& cfg, const CountedLoop& counted,
+                                      const Liveness& liveness, const VariableIndex& vars,
+                                      const RangeAnalysis& ranges) {
+    const std::string& counter = counted.counter;
+    bool up = counted.step == 1 && (counted.cmp == "<" || counted.cmp == "<=");
+    bool down = counted.step == -1 && (counted.cmp == ">" || counted.cmp == ">=");
+    if (!up && !down) return false;
+
+    // --- Everything the loop leaves behind must have a closed form ---
+    for (size_t i : counted.trip) {
+        if (program[i].kind == Instr::PRINT || mayTrap(program[i])) return false;
+    }
+    std::vector<std::string> accumulators;
+    bool counterLive = false;
+    for (const auto& entry : counted.tripEffect) {
+        const std::string& var = entry.first;
+        const Affine& effect = entry.second;
+        if (!liveIn(liveness, vars, counted.exitBlock, var)) continue;
+        if (var == counter) {
+            counterLive = true;
+            continue;
+        }
+        if (!effect.known || effect.coefficient(var) != 1) return false;
+        for (const auto& term : effect.terms) {
+            if (term.first != var && term.first != counter && counted.tripEffect.count(term.first)) return false;
+        }
+        accumulators.push_back(var);
+    }
+
+    // --- The replacement, at the header ---
+    int firstTemp = tempCounter, firstLabel = labelCounter; // To take back the names if it is not used
+    const BasicBlock& header = cfg.blocks[counted.loop.header];
+    const BasicBlock& exit = cfg.blocks[counted.exitBlock];
+    bool newExitLabel = program[exit.first].kind != Instr::LABEL;
+    std::string exitLabel = newExitLabel ? newLabel("LBL_EXIT") : program[exit.first].label;
+
+    std::vector<Instr> code;
+    code.push_back(program[header.first]);
+    for (size_t i : counted.entry) code.push_back(program[i]);
+    Instr test;
+    test.kind = Instr::IF;
+    test.a = counter;
+    test.op = invertComparison(counted.cmp);
+    test.b = counted.bound;
+    test.label = exitLabel;
+    code.push_back(test);
+
+    // --- The closed form: what each accumulator gains over all trips ---
+    size_t closedFormStart = code.size();
+    std::vector<Instr> updates; // Then "acc = acc + gain", "i = i + n"
+    std::string trips = newTemp();
+    code.push_back(up ? makeBinary(trips, counted.bound, "-", counter) : makeBinary(trips, counter, "-", counted.bound));
+    if (counted.cmp == "<=" || counted.cmp == ">=") code.push_back(makeBinary(trips, trips, "+", "1"));
+
+    std::string triangle; // n*(n-1)/2, the sum of 0 .. n-1
+    for (const std::string& acc : accumulators) {
+        const Affine& effect = counted.tripEffect.at(acc);
+        std::vector<std::string> parts;
+        long long slope = effect.coefficient(counter);
+        if (slope != 0) {
+            if (triangle.empty()) {
+                triangle = newTemp();
+                code.push_back(makeBinary(triangle, trips, "-", "1"));
+                code.push_back(makeBinary(triangle, triangle, "*", trips));
+                code.push_back(makeBinary(triangle, triangle, "/", "2"));
+            }
+            std::string sum = newTemp();
+            code.push_back(makeBinary(sum, trips, "*", counter));
+            code.push_back(makeBinary(sum, sum, up ? "+" : "-", triangle));
+            if (slope != 1) code.push_back(makeBinary(sum, sum, "*", std::to_string(slope)));
+            parts.push_back(sum);
+        }
+        if (effect.constant == 1) {
+            parts.push_back(trips);
+        } else if (effect.constant != 0) {
+            std::string sum = newTemp();
+            code.push_back(makeBinary(sum, trips, "*", std::to_string(effect.constant)));
+            parts.push_back(sum);
+        }
+        for (const auto& term : effect.terms) {
+            if (term.first == acc || term.first == counter) continue;
+            std::string sum = newTemp();
+            code.push_back(makeBinary(sum, trips, "*", term.first));
+            if (term.second != 1) code.push_back(makeBinary(sum, sum, "*", std::to_string(term.second)));
+            parts.push_back(sum);
+        }
+        if (parts.empty()) continue;
+
+        std::string gain = parts[0];
+        if (parts.size() > 1) {
+            gain = newTemp();
+            code.push_back(makeBinary(gain, parts[0], "+", parts[1]));
+            for (size_t k = 2; k < parts.size(); ++k) code.push_back(makeBinary(gain, gain, "+", parts[k]));
+        }
+        updates.push_back(makeBinary(acc, acc, "+", gain));
+    }
+    if (counterLive) updates.push_back(makeBinary(counter, counter, up ? "+" : "-", trips));
+
+    // The updates give the values the loop would leave. Everything before
+    // them must stay in range whenever the loop runs.
+    RangeMap entering;
+    bool bounded = ranges.enteringLoop(counted.loop, entering);
+    for (size_t i : counted.entry) applyRanges(program[i], entering);
+    bounded = bounded && narrowRanges(counter, counted.cmp, counted.bound, entering);
+    for (size_t k = closedFormStart; k < code.size() && bounded; ++k) {
+        applyRanges(code[k], entering);
+        bounded = !operandRange(code[k].dst, entering).isFull();
+    }
+    if (!bounded) {
+        tempCounter = firstTemp;
+        labelCounter = firstLabel;
+        return false;
+    }
+    code.insert(code.end(), updates.begin(), updates.end());
+    code.push_back(makeGoto(exitLabel));
+
+    std::vector<Instr> result;
+    result.reserve(program.size() + code.size());
+    for (size_t i = 0; i < program.size(); ++i) {
+        if (i == header.first) result.insert(result.end(), code.begin(), code.end());
+        if (i == exit.first && newExitLabel) result.push_back(makeLabel(exitLabel));
+        if (!counted.loop.contains(cfg.blockOf[i])) result.push_back(program[i]);
+    }
+    program = std::move(result);
+    ++stats.loopsReplaced;
+    return true;
+}
+
+bool Optimizer::reduceMultiplication(const ControlFlowGraph& cfg, const Loop& loop,
+                                     const Liveness& liveness, const VariableIndex& vars) {
+    std::unordered_map<std::string, int> defCount;
+    std::unordered_map<std::string, size_t> defAt;
+    for (int b : loop.blocks) {
+        for (size_t i = cfg.blocks[b].first; i < cfg.blocks[b].last; ++i) {
+            if (program[i].kind != Instr::ASSIGN) continue;
+            ++defCount[program[i].dst];
+            defAt[program[i].dst] = i;
+        }
+    }
+    auto invariant = [&](const std::string& operand) {
+        return isLiteral(operand) || (isVariable(operand) && !defCount.count(operand));
+    };
+    // The increment of i if it is "i = i + c" / "i = c + i" / "i = i - c", its only assignment
+    auto increment = [&](const std::string& var, long long& step) -> long long {
+        auto count = defCount.find(var);
+        if (count == defCount.end() || count->second != 1) return -1;
+        long long at = static_cast<long long>(defAt[var]);
+        const Instr& def = program[at];
+        if (def.op == "+" && def.a == var && literalValue(def.b, step)) return at;
+        if (def.op == "+" && def.b == var && literalValue(def.a, step)) return at;
+        if (def.op == "-" && def.a == var && !def.b.empty() && literalValue(def.b, step)) {
+            step = -step;
+            return at;
+        }
+        return -1;
+    };
+    std::vector<int> exitTargets;
+    for (int b : loop.blocks) {
+        for (int succ : cfg.blocks[b].succs) {
+            if (!loop.contains(succ)) exitTargets.push_back(succ);
+        }
+    }
+
+    for (int b : loop.blocks) {
+        for (size_t i = cfg.blocks[b].first; i < cfg.blocks[b].last; ++i) {
+            const Instr& mul = program[i];
+            if (mul.kind != Instr::ASSIGN || mul.op != "*") continue;
+
+            long long c = 0;
+            std::string iv = mul.a, factor = mul.b;
+            long long inc = increment(iv, c);
+            if (inc == -1 || !invariant(factor)) {
+                std::swap(iv, factor);
+                inc = increment(iv, c);
+            }
+            if (inc == -1 || !invariant(factor) || c == 0) continue;
+
+            // d must hold i * k wherever it is read
+            const std::string& d = mul.dst;
+            if (d == iv || defCount.at(d) != 1 || liveIn(liveness, vars, loop.header, d)) continue;
+            bool readAfterLoop = false;
+            for (int target : exitTargets) {
+                if (liveIn(liveness, vars, target, d)) readAfterLoop = true;
+            }
+            if (readAfterLoop || cfg.blockOf[inc] != b) continue;
+            if (static_cast<long long>(i) < inc) {
+                // Computed before the increment: no read of d may follow it
+                const std::vector<int>& out = liveness.liveOut[b];
+                bool live = std::binary_search(out.begin(), out.end(), vars.find(d));
+                for (size_t k = cfg.blocks[b].last; k-- > static_cast<size_t>(inc) + 1;) {
+                    if (program[k].kind == Instr::ASSIGN && program[k].dst == d) live = false;
+                    for (const auto& name : instrUses(program[k])) {
+                        if (name == d) live = true;
+                    }
+                }
+                if (live) continue;
+            }
+
+            // --- Step of d per increment of i ---
+            std::vector<Instr> preheader;
+            long long factorValue, stepValue;
+            std::string stepOperand, stepOp = c > 0 ? "+" : "-";
+            if (literalValue(factor, factorValue)) {
+                if (!evalBasicBinary("*", c, factorValue, stepValue) || stepValue == SPL_INT_MIN) continue;
+                stepOp = stepValue >= 0 ? "+" : "-";
+                stepOperand = std::to_string(stepValue >= 0 ? stepValue : -stepValue);
+            } else if (c == 1 || c == -1) {
+                stepOperand = factor;
+            } else {
+                if (c == SPL_INT_MIN) continue;
+                stepOperand = newTemp();
+                preheader.push_back(makeBinary(stepOperand, factor, "*", std::to_string(c > 0 ? c : -c)));
+            }
+            preheader.push_back(mul);
+
+            std::string preheaderLabel = redirectLoopEntries(cfg, loop);
+            const BasicBlock& header = cfg.blocks[loop.header];
+            std::vector<Instr> result;
+            result.reserve(program.size() + preheader.size() + 1);
+            for (size_t k = 0; k < program.size(); ++k) {
+                if (k == header.first) {
+                    if (!preheaderLabel.empty()) result.push_back(makeLabel(preheaderLabel));
+                    result.insert(result.end(), preheader.begin(), preheader.end());
+                }
+                if (k != i) result.push_back(program[k]);
+                if (static_cast<long long>(k) == inc) result.push_back(makeBinary(d, d, stepOp, stepOperand));
+            }
+            program = std::move(result);
+            ++stats.multiplicationsReduced;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,117 @@
+#include "optimizer.h"
+#include <algorithm>
+
+static bool liveAt(const Liveness& liveness, int block, int v) {
+    const std::vector<int>& live = liveness.liveIn[block];
+    return std::binary_search(live.begin(), live.end(), v);
+}
+
+/**
+ * @brief Loop-invariant code motion.
+ * Finds the natural loops of the code (the back edges of while and do-until
+ * lowerings and of inlined bodies) and moves assignments whose operands do not
+ * change inside the loop into a preheader in front of the header label. An
+ * assignment qualifies if it is the only one to its variable in the loop, the
+ * variable's old value is not read in the loop, and it cannot trap. If the
+ * variable is read after the loop, the assignment must also run before every
+ * exit. Jumps from outside the loop are sent to the preheader; the back edges
+ * keep jumping to the header. Loops are handled innermost first, and the
+ * analyses are rebuilt after every loop that changed, so code hoisted out of
+ * an inner loop can leave the outer one too.
+ */
+bool Optimizer::hoistInvariants() {
+    bool changedAny = false;
+
+    for (size_t round = 0; round < program.size(); ++round) {
+        ControlFlowGraph cfg;
+        cfg.build(program);
+        if (cfg.blocks.empty()) break;
+        DominatorTree dom;
+        dom.build(cfg);
+        std::vector<Loop> loops = findLoops(cfg, dom);
+        VariableIndex vars;
+        Liveness liveness;
+        liveness.compute(program, cfg, vars);
+
+        bool changed = false;
+        for (const Loop& loop : loops) {
+            if (!hasPreheaderSlot(cfg, loop)) continue;
+            const BasicBlock& header = cfg.blocks[loop.header];
+
+            std::vector<int> defCount(vars.names.size(), 0);
+            for (int b : loop.blocks) {
+                for (size_t i = cfg.blocks[b].first; i < cfg.blocks[b].last; ++i) {
+                    if (program[i].kind == Instr::ASSIGN) ++defCount[vars.id(program[i].dst)];
+                }
+            }
+            std::vector<int> exiting, exitTargets;
+            for (int b : loop.blocks) {
+                for (int succ : cfg.blocks[b].succs) {
+                    if (loop.contains(succ)) continue;
+                    exiting.push_back(b);
+                    exitTargets.push_back(succ);
+                }
+            }
+
+            // --- Pick the invariant assignments, operands first ---
+            std::vector<char> invariant(vars.names.size(), 0);
+            std::vector<char> hoisted(program.size(), 0);
+            std::vector<size_t> chosen;
+            bool progress = true;
+            while (progress) {
+                progress = false;
+                for (int b : loop.blocks) {
+                    for (size_t i = cfg.blocks[b].first; i < cfg.blocks[b].last; ++i) {
+                        const Instr& instr = program[i];
+                        if (instr.kind != Instr::ASSIGN || hoisted[i] || mayTrap(instr)) continue;
+                        int dst = vars.id(instr.dst);
+                        if (defCount[dst] != 1 || liveAt(liveness, loop.header, dst)) continue;
+
+                        bool operandsInvariant = true;
+                        for (const auto& name : instrUses(instr)) {
+                            int v = vars.id(name);
+                            if (defCount[v] != 0 && !invariant[v]) operandsInvariant = false;
+                        }
+                        if (!operandsInvariant) continue;
+
+                        bool readAfter = false;
+                        for (int target : exitTargets) {
+                            if (liveAt(liveness, target, dst)) readAfter = true;
+                        }
+                        bool runsBeforeExits = true;
+                        for (int e : exiting) {
+                            if (!dom.dominates(b, e)) runsBeforeExits = false;
+                        }
+                        if (readAfter && !runsBeforeExits) continue;
+
+                        hoisted[i] = 1;
+                        invariant[dst] = 1;
+                        chosen.push_back(i);
+                        progress = true;
+                    }
+                }
+            }
+            if (chosen.empty()) continue;
+
+            // --- Preheader ---
+            std::string preheaderLabel = redirectLoopEntries(cfg, loop);
+            std::vector<Instr> result;
+            result.reserve(program.size() + 1);
+            for (size_t i = 0; i < header.first; ++i) {
+                if (!hoisted[i]) result.push_back(program[i]);
+            }
+            if (!preheaderLabel.empty()) result.push_back(makeLabel(preheaderLabel));
+            for (size_t i : chosen) result.push_back(program[i]);
+            for (size_t i = header.first; i < program.size(); ++i) {
+                if (!hoisted[i]) result.push_back(program[i]);
+            }
+            program = std::move(result);
+            stats.invariantsHoisted += static_cast<int>(chosen.size());
+            changed = true;
+            break;
+        }
+        if (!changed) break;
+        changedAny = true;
+    }
+    return changedAny;
+}
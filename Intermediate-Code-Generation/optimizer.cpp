@@ -0,0 +1,162 @@
+#include "optimizer.h"
+#include <iostream>
+#include <algorithm>
+#include <cctype>
+
+// The number at the end of a generated name ("t12", "LBL_EXIT_7"), or 0
+static int trailingNumber(const std::string& name, size_t from) {
+    if (from >= name.size()) return 0;
+    for (size_t i = from; i < name.size(); ++i) {
+        if (!std::isdigit(static_cast<unsigned char>(name[i]))) return 0;
+    }
+    return name.size() - from > 9 ? 0 : std::stoi(name.substr(from));
+}
+
+// "1 loop", "2 loops"
+static std::string plural(int count, const std::string& noun) {
+    return std::to_string(count) + " " + noun + (count == 1 ? "" : "s");
+}
+
+// =================== PUBLIC ===================
+
+void Optimizer::optimize(std::vector<std::string>& code) {
+    program.clear();
+    program.reserve(code.size());
+    tempCounter = labelCounter = 0;
+    for (const auto& line : code) {
+        program.push_back(parseInstr(line));
+        const Instr& instr = program.back();
+        // Lines the passes do not understand (e.g. a call left behind by a
+        // failed inlining) could read or jump anywhere: leave the code alone.
+        if (instr.kind == Instr::OTHER) return;
+
+        for (const std::string* name : {&instr.dst, &instr.a, &instr.b}) {
+            if (name->size() > 1 && (*name)[0] == 't') tempCounter = std::max(tempCounter, trailingNumber(*name, 1));
+        }
+        if (!instr.label.empty()) {
+            labelCounter = std::max(labelCounter, trailingNumber(instr.label, instr.label.rfind('_') + 1));
+        }
+    }
+
+    propagateConstants();
+    eliminateDeadCode();
+    // Straightened control flow exposes code after GOTOs that is now unreachable
+    while (simplifyControlFlow() && eliminateDeadCode()) {
+    }
+    if (numberValues()) eliminateDeadCode();
+    hoistInvariants();
+    unswitchLoops();
+    // Merges the SSA versions back, so it has to come after value numbering
+    coalesceVariables();
+    // Copies no longer hide which variable a test narrows
+    if (foldComparisons()) eliminateDeadCode();
+    // One name per variable again, so counters are recognisable. The new
+    // preheader code often starts from a known counter value.
+    if (reduceInductionVariables()) propagateConstants();
+    // Unrolled counters become constants, and most of their updates dead
+    if (unrollLoops()) {
+        propagateConstants();
+        eliminateDeadCode();
+    }
+    while (simplifyControlFlow() && eliminateDeadCode()) {
+    }
+
+    code.clear();
+    code.reserve(program.size());
+    for (const auto& instr : program) {
+        code.push_back(renderInstr(instr));
+    }
+}
+
+void Optimizer::printReport(std::ostream& out) const {
+    // Only the passes that changed something
+    if (stats.deadStoresRemoved || stats.unreachableRemoved) {
+        out << "Dead code elimination removed " << plural(stats.deadStoresRemoved, "dead store") << " and "
+            << plural(stats.unreachableRemoved, "unreachable instruction") << std::endl;
+    }
+    if (stats.redundantRemoved) {
+        out << "Value numbering removed " << plural(stats.redundantRemoved, "redundant computation") << std::endl;
+    }
+    if (stats.invariantsHoisted) {
+        out << "Loop-invariant code motion hoisted " << plural(stats.invariantsHoisted, "instruction") << std::endl;
+    }
+    if (stats.loopsUnswitched) {
+        out << "Loop unswitching copied " << plural(stats.loopsUnswitched, "loop") << std::endl;
+    }
+    if (stats.comparisonsFolded) {
+        out << "Value ranges decided " << plural(stats.comparisonsFolded, "comparison") << std::endl;
+    }
+    if (stats.loopsReplaced || stats.multiplicationsReduced) {
+        out << "Induction variables: " << plural(stats.loopsReplaced, "loop") << " replaced by closed forms, "
+            << plural(stats.multiplicationsReduced, "multiplication") << " reduced" << std::endl;
+    }
+    if (stats.loopsUnrolled || stats.loopsUnrolledPartially) {
+        out << "Loop unrolling: " << plural(stats.loopsUnrolled, "loop") << " fully unrolled, "
+            << stats.loopsUnrolledPartially << " partially" << std::endl;
+    }
+    if (stats.variablesAfter < stats.variablesBefore) {
+        out << "Variable coalescing reduced " << plural(stats.variablesBefore, "variable") << " to "
+            << stats.variablesAfter << std::endl;
+    }
+}
+
+// =================== PRIVATE ===================
+
+void Optimizer::removeDeleted(const std::vector<bool>& deleted) {
+    size_t kept = 0;
+    for (size_t i = 0; i < program.size(); ++i) {
+        if (!deleted[i]) {
+            if (kept != i) program[kept] = std::move(program[i]);
+            ++kept;
+        }
+    }
+    program.resize(kept);
+}
+
+std::string Optimizer::newTemp() {
+    ++tempCounter;
+    return "t" + std::to_string(tempCounter);
+}
+
+std::string Optimizer::newLabel(const std::string& prefix) {
+    ++labelCounter;
+    return prefix + "_" + std::to_string(labelCounter);
+}
+
+void Optimizer::appendDetached(std::vector<Instr>& code, const std::vector<Instr>& blocks) {
+    if (blocks.empty()) return;
+    // A program that runs off its end must still do so, without a STOP
+    Instr::Kind last = code.empty() ? Instr::STOP : code.back().kind;
+    std::string end;
+    if (last != Instr::GOTO && last != Instr::STOP) {
+        end = newLabel("LBL_END");
+        code.push_back(makeGoto(end));
+    }
+    code.insert(code.end(), blocks.begin(), blocks.end());
+    if (!end.empty()) code.push_back(makeLabel(end));
+}
+
+bool Optimizer::hasPreheaderSlot(const ControlFlowGraph& cfg, const Loop& loop) const {
+    if (program[cfg.blocks[loop.header].first].kind != Instr::LABEL) return false;
+    // A loop block falling into the header would run the preheader every iteration
+    if (loop.header > 0 && loop.contains(loop.header - 1)) {
+        Instr::Kind kind = program[cfg.blocks[loop.header - 1].last - 1].kind;
+        if (kind != Instr::GOTO && kind != Instr::STOP) return false;
+    }
+    return true;
+}
+
+std::string Optimizer::redirectLoopEntries(const ControlFlowGraph& cfg, const Loop& loop) {
+    const BasicBlock& header = cfg.blocks[loop.header];
+    const std::string headerLabel = program[header.first].label;
+    std::string preheaderLabel;
+    for (int pred : header.preds) {
+        if (loop.contains(pred)) continue;
+        Instr& tail = program[cfg.blocks[pred].last - 1];
+        if ((tail.kind == Instr::GOTO || tail.kind == Instr::IF) && tail.label == headerLabel) {
+            if (preheaderLabel.empty()) preheaderLabel = newLabel("LBL_PRE");
+            tail.label = preheaderLabel;
+        }
+    }
+    return preheaderLabel;
+}
@@ -0,0 +1,81 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "ir.h"
+
+struct CountedLoop;
+class RangeAnalysis;
+
+// Constants known to hold at a program point: variable -> value
+typedef std::unordered_map<std::string, long long> ConstMap;
+
+// What the passes removed, for the summary printed after optimisation
+struct OptimizerStats {
+    int deadStoresRemoved = 0;
+    int unreachableRemoved = 0;
+    int redundantRemoved = 0;  // Computations value numbering found available
+    int invariantsHoisted = 0;
+    int loopsUnswitched = 0;
+    int comparisonsFolded = 0; // Decided by value ranges
+    int loopsReplaced = 0;           // Loops turned into their closed form
+    int multiplicationsReduced = 0;  // Products of an induction variable turned into additions
+    int loopsUnrolled = 0;           // Loops replaced by copies of every trip
+    int loopsUnrolledPartially = 0;  // Loops testing once per UNROLL_FACTOR trips
+    int variablesBefore = 0;   // Distinct variables before coalescing
+    int variablesAfter = 0;
+};
+
+/**
+ * @brief Optimisation passes over the generated BASIC.
+ * Runs after performInlining and before startPostProcess: the code is parsed
+ * once into Instr form, every pass rewrites that list, and the result is
+ * written back as lines for post-processing.
+ */
+class Optimizer {
+public:
+    void optimize(std::vector<std::string>& code);
+    void printReport(std::ostream& out = std::cout) const;
+    const OptimizerStats& getStats() const { return stats; }
+
+private:
+    std::vector<Instr> program;
+    OptimizerStats stats;
+    int tempCounter = 0;   // Highest tN and LBL_x_N in the code, for fresh names
+    int labelCounter = 0;
+
+    // --- Passes (one file each) ---
+    bool propagateConstants();          // sccp.cpp
+    bool eliminateDeadCode();           // dce.cpp
+    bool simplifyControlFlow();         // peephole.cpp
+    bool numberValues();                // gvn.cpp
+    bool hoistInvariants();             // licm.cpp
+    bool unswitchLoops();               // unswitch.cpp
+    bool foldComparisons();             // vrp.cpp
+    bool reduceInductionVariables();    // ivopt.cpp
+    bool unrollLoops();                 // unroll.cpp
+    bool coalesceVariables();           // coalesce.cpp
+
+    // --- ivopt.cpp ---
+    bool replaceWithClosedForm(const ControlFlowGraph& cfg, const CountedLoop& counted,
+                               const Liveness& liveness, const VariableIndex& vars,
+                               const RangeAnalysis& ranges);
+    bool reduceMultiplication(const ControlFlowGraph& cfg, const Loop& loop,
+                              const Liveness& liveness, const VariableIndex& vars);
+
+    // --- Shared helpers ---
+    void removeDeleted(const std::vector<bool>& deleted);
+    std::string newTemp();
+    std::string newLabel(const std::string& prefix);
+    // Blocks entered only by jumps go after the end of the program
+    void appendDetached(std::vector<Instr>& code, const std::vector<Instr>& blocks);
+    // Code can be put in front of the header label without running every iteration
+    bool hasPreheaderSlot(const ControlFlowGraph& cfg, const Loop& loop) const;
+    // Sends jumps into the loop from outside to a new preheader label ("" if there are none)
+    std::string redirectLoopEntries(const ControlFlowGraph& cfg, const Loop& loop);
+};
+
+#endif // OPTIMIZER_H
@@ -0,0 +1,41 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Splitting work on the generated code over the hardware threads.
+ * Used by the back end on very large outputs (line numbering, label
+ * resolution, rendering). Each chunk is a contiguous range of lines, and
+ * chunks are numbered in order so per-chunk results can be combined in order.
+ */
+
+// Number of chunks for n items: one per hardware thread, but no chunk
+// smaller than minChunk, so small programs stay on the calling thread
+inline size_t chunkCount(size_t n, size_t minChunk) {
+    size_t threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+    size_t chunks = n / minChunk;
+    if (chunks > threads) chunks = threads;
+    return chunks == 0 ? 1 : chunks;
+}
+
+// First item of chunk c when n items are split into the given number of chunks
+inline size_t chunkBegin(size_t c, size_t n, size_t chunks) {
+    return n / chunks * c + (c < n % chunks ? c : n % chunks);
+}
+
+// Runs body(c, begin, end) for every chunk; chunk 0 runs on the calling thread
+template <typename Body>
+void forEachChunk(size_t n, size_t chunks, Body body) {
+    std::vector<std::thread> workers;
+    for (size_t c = 1; c < chunks; ++c) {
+        workers.emplace_back(body, c, chunkBegin(c, n, chunks), chunkBegin(c + 1, n, chunks));
+    }
+    body(0, chunkBegin(0, n, chunks), chunkBegin(1, n, chunks));
+    for (auto& worker : workers) worker.join();
+}
+
+#endif // PARALLEL_H
@@ -0,0 +1,124 @@
+#include "optimizer.h"
+
+static bool isJump(const Instr& instr) {
+    return instr.kind == Instr::GOTO || instr.kind == Instr::IF;
+}
+
+// Index of the first non-label instruction at or after i
+static size_t skipLabels(const std::vector<Instr>& code, size_t i) {
+    while (i < code.size() && code[i].kind == Instr::LABEL) ++i;
+    return i;
+}
+
+// True if label is defined in the run of labels starting at i
+static bool labelInRun(const std::vector<Instr>& code, size_t i, const std::string& label) {
+    for (; i < code.size() && code[i].kind == Instr::LABEL; ++i) {
+        if (code[i].label == label) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Peephole simplification of the emitted control flow.
+ * - Jump threading: a jump whose target starts with GOTO M goes to M directly,
+ *   and a GOTO whose target is STOP becomes STOP (unless one of the rules
+ *   below removes it).
+ * - "IF c THEN L1 / GOTO L2 / REM L1" becomes "IF not c THEN L2" so the common
+ *   case falls through (the shape genCondition and do-until produce).
+ * - Jumps to the next instruction are deleted.
+ * - Runs of labels are merged into one and unreferenced labels are dropped.
+ * Repeats until nothing changes.
+ */
+bool Optimizer::simplifyControlFlow() {
+    bool changedAny = false;
+    bool changed = true;
+
+    while (changed) {
+        changed = false;
+        std::unordered_map<std::string, size_t> labelAt;
+        for (size_t i = 0; i < program.size(); ++i) {
+            if (program[i].kind == Instr::LABEL) labelAt[program[i].label] = i;
+        }
+
+        // --- Jump threading ---
+        for (size_t i = 0; i < program.size(); ++i) {
+            Instr& instr = program[i];
+            if (!isJump(instr)) continue;
+            std::string target = instr.label;
+            size_t landing = program.size();
+            // Bounded so a cycle of GOTOs cannot hang the compiler
+            for (size_t hops = 0; hops < program.size(); ++hops) {
+                auto it = labelAt.find(target);
+                if (it == labelAt.end()) break;
+                landing = skipLabels(program, it->second);
+                if (landing >= program.size() || program[landing].kind != Instr::GOTO || program[landing].label == target) break;
+                target = program[landing].label;
+            }
+            // A GOTO to the next instruction is deleted below, and one that an
+            // IF jumps over is folded into the IF; as STOPs both would stay
+            bool removable = labelInRun(program, i + 1, instr.label) ||
+                (i > 0 && program[i - 1].kind == Instr::IF && labelInRun(program, i + 1, program[i - 1].label));
+            if (instr.kind == Instr::GOTO && !removable && landing < program.size() && program[landing].kind == Instr::STOP) {
+                instr = program[landing];
+                changed = true;
+            } else if (target != instr.label) {
+                instr.label = target;
+                changed = true;
+            }
+        }
+
+        std::vector<bool> deleted(program.size(), false);
+        for (size_t i = 0; i < program.size(); ++i) {
+            if (deleted[i] || !isJump(program[i])) continue;
+            Instr& instr = program[i];
+
+            // --- Jump over a GOTO: invert the condition ---
+            if (instr.kind == Instr::IF && i + 1 < program.size() && program[i + 1].kind == Instr::GOTO &&
+                labelInRun(program, i + 2, instr.label)) {
+                instr.op = invertComparison(instr.op);
+                instr.label = program[i + 1].label;
+                deleted[i + 1] = true;
+                changed = true;
+                continue;
+            }
+
+            // --- Jump to the next instruction ---
+            if (labelInRun(program, i + 1, instr.label)) {
+                deleted[i] = true;
+                changed = true;
+            }
+        }
+        removeDeleted(deleted);
+
+        // --- Merge label runs and drop unreferenced labels ---
+        std::unordered_map<std::string, std::string> canonical;
+        for (size_t i = 0; i < program.size(); ++i) {
+            if (program[i].kind != Instr::LABEL) continue;
+            size_t end = skipLabels(program, i);
+            for (size_t k = i + 1; k < end; ++k) canonical[program[k].label] = program[i].label;
+            i = end - 1;
+        }
+        std::unordered_map<std::string, int> references;
+        for (size_t i = 0; i < program.size(); ++i) {
+            Instr& instr = program[i];
+            if (!isJump(instr)) continue;
+            auto it = canonical.find(instr.label);
+            if (it != canonical.end()) {
+                instr.label = it->second;
+                changed = true;
+            }
+            ++references[instr.label];
+        }
+        deleted.assign(program.size(), false);
+        for (size_t i = 0; i < program.size(); ++i) {
+            if (program[i].kind == Instr::LABEL && !references.count(program[i].label)) {
+                deleted[i] = true;
+                changed = true;
+            }
+        }
+        removeDeleted(deleted);
+
+        changedAny = changedAny || changed;
+    }
+    return changedAny;
+}
@@ -0,0 +1,325 @@
+#include "ranges.h"
+#include <algorithm>
+#include <deque>
+
+// Changes of a block's entry ranges before its bounds are widened
+static const int WIDEN_AFTER = 3;
+// Rounds of narrowing once the widened ranges are stable
+static const int NARROW_ROUNDS = 2;
+
+// =================== Ranges ===================
+
+ValueRange ValueRange::of(long long lo, long long hi) {
+    ValueRange range;
+    if (lo >= SPL_INT_MIN && hi <= SPL_INT_MAX) {
+        range.lo = lo;
+        range.hi = hi;
+    }
+    return range;
+}
+
+ValueRange operandRange(const std::string& operand, const RangeMap& ranges) {
+    long long value;
+    if (literalValue(operand, value)) return ValueRange::constant(value);
+    auto it = ranges.find(operand);
+    return it == ranges.end() ? ValueRange() : it->second;
+}
+
+static void setRange(RangeMap& ranges, const std::string& var, const ValueRange& range) {
+    if (range.isFull()) ranges.erase(var);
+    else ranges[var] = range;
+}
+
+// Rounding x / y down and up (y != 0)
+static long long floorDiv(long long x, long long y) {
+    long long q = x / y;
+    return (x % y != 0 && (x < 0) != (y < 0)) ? q - 1 : q;
+}
+
+static long long ceilDiv(long long x, long long y) {
+    long long q = x / y;
+    return (x % y != 0 && (x < 0) == (y < 0)) ? q + 1 : q;
+}
+
+bool isComparison(const std::string& op) {
+    return op == "=" || op == "<>" || op == "<" || op == ">" || op == "<=" || op == ">=";
+}
+
+static ValueRange binaryRange(const std::string& op, const ValueRange& a, const ValueRange& b) {
+    if (op == "+") return ValueRange::of(a.lo + b.lo, a.hi + b.hi);
+    if (op == "-") return ValueRange::of(a.lo - b.hi, a.hi - b.lo);
+    if (op == "*") {
+        long long corners[] = {a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi};
+        return ValueRange::of(*std::min_element(corners, corners + 4), *std::max_element(corners, corners + 4));
+    }
+    if (op == "/") {
+        if (b.contains(0)) return ValueRange();
+        long long lows[] = {floorDiv(a.lo, b.lo), floorDiv(a.lo, b.hi), floorDiv(a.hi, b.lo), floorDiv(a.hi, b.hi)};
+        long long highs[] = {ceilDiv(a.lo, b.lo), ceilDiv(a.lo, b.hi), ceilDiv(a.hi, b.lo), ceilDiv(a.hi, b.hi)};
+        return ValueRange::of(*std::min_element(lows, lows + 4), *std::max_element(highs, highs + 4));
+    }
+    if (isComparison(op)) {
+        int outcome = compareRanges(a, op, b);
+        return outcome == -1 ? ValueRange::of(-1, 0) : ValueRange::constant(outcome ? -1 : 0);
+    }
+    // AND/OR of truth values is a truth value
+    if ((op == "AND" || op == "OR") && a.lo >= -1 && a.hi <= 0 && b.lo >= -1 && b.hi <= 0) {
+        return ValueRange::of(-1, 0);
+    }
+    return ValueRange();
+}
+
+void applyRanges(const Instr& instr, RangeMap& ranges) {
+    if (instr.kind != Instr::ASSIGN) return;
+    ValueRange a = operandRange(instr.a, ranges);
+    ValueRange result;
+    if (instr.op.empty()) {
+        result = a;
+    } else if (instr.b.empty()) { // Negation
+        result = a.lo == SPL_INT_MIN ? ValueRange() : ValueRange::of(-a.hi, -a.lo);
+    } else {
+        result = binaryRange(instr.op, a, operandRange(instr.b, ranges));
+    }
+    setRange(ranges, instr.dst, result);
+}
+
+int compareRanges(const ValueRange& a, const std::string& op, const ValueRange& b) {
+    if (op == "<") {
+        if (a.hi < b.lo) return 1;
+        if (a.lo >= b.hi) return 0;
+    }
+    else if (op == "<=") {
+        if (a.hi <= b.lo) return 1;
+        if (a.lo > b.hi) return 0;
+    }
+    else if (op == ">") {
+        return compareRanges(b, "<", a);
+    }
+    else if (op == ">=") {
+        return compareRanges(b, "<=", a);
+    }
+    else if (op == "=" || op == "<>") {
+        int equal = -1;
+        if (a.isConstant() && b.isConstant() && a.lo == b.lo) equal = 1;
+        if (a.hi < b.lo || b.hi < a.lo) equal = 0;
+        if (equal == -1 || op == "=") return equal;
+        return 1 - equal;
+    }
+    return -1;
+}
+
+// Narrows a and b to the values for which "a op b" holds. False if there are none.
+static bool refine(const std::string& op, ValueRange& a, ValueRange& b) {
+    if (op == "<") {
+        a.hi = std::min(a.hi, b.hi - 1);
+        b.lo = std::max(b.lo, a.lo + 1);
+    }
+    else if (op == "<=") {
+        a.hi = std::min(a.hi, b.hi);
+        b.lo = std::max(b.lo, a.lo);
+    }
+    else if (op == ">") {
+        return refine("<", b, a);
+    }
+    else if (op == ">=") {
+        return refine("<=", b, a);
+    }
+    else if (op == "=") {
+        a.lo = b.lo = std::max(a.lo, b.lo);
+        a.hi = b.hi = std::min(a.hi, b.hi);
+    }
+    else if (op == "<>") {
+        // Only a constant at the edge of the other range takes anything away
+        for (auto pair : {std::make_pair(&a, &b), std::make_pair(&b, &a)}) {
+            ValueRange& range = *pair.first;
+            const ValueRange& other = *pair.second;
+            if (!other.isConstant()) continue;
+            if (range.lo == other.lo) ++range.lo;
+            if (range.hi == other.lo) --range.hi;
+        }
+    }
+    return a.lo <= a.hi && b.lo <= b.hi;
+}
+
+bool narrowRanges(const std::string& a, const std::string& op, const std::string& b, RangeMap& ranges) {
+    ValueRange left = operandRange(a, ranges), right = operandRange(b, ranges);
+    if (!refine(op, left, right)) return false;
+    if (isVariable(a)) setRange(ranges, a, left);
+    if (isVariable(b)) setRange(ranges, b, right);
+    return true;
+}
+
+// =================== Analysis ===================
+
+// Ranges true at a join: each variable's hull, unknown where either side is
+static RangeMap hull(const RangeMap& x, const RangeMap& y) {
+    RangeMap result;
+    for (const auto& entry : x) {
+        auto it = y.find(entry.first);
+        if (it == y.end()) continue;
+        ValueRange range = ValueRange::of(std::min(entry.second.lo, it->second.lo),
+                                          std::max(entry.second.hi, it->second.hi));
+        if (!range.isFull()) result[entry.first] = range;
+    }
+    return result;
+}
+
+static bool sameRanges(const RangeMap& x, const RangeMap& y) {
+    if (x.size() != y.size()) return false;
+    for (const auto& entry : x) {
+        auto it = y.find(entry.first);
+        if (it == y.end() || it->second.lo != entry.second.lo || it->second.hi != entry.second.hi) return false;
+    }
+    return true;
+}
+
+// Widening goes to one short of the ends of the range first: a counter below
+// some bound (i < n) can still be stepped by one without leaving the range.
+static long long widenUp(long long hi) {
+    return hi <= SPL_INT_MAX - 1 ? SPL_INT_MAX - 1 : SPL_INT_MAX;
+}
+
+static long long widenDown(long long lo) {
+    return lo >= SPL_INT_MIN + 1 ? SPL_INT_MIN + 1 : SPL_INT_MIN;
+}
+
+void RangeAnalysis::runBlock(int block, RangeMap& ranges) const {
+    const BasicBlock& bb = cfg->blocks[block];
+    for (size_t i = bb.first; i < bb.last; ++i) applyRanges((*code)[i], ranges);
+}
+
+ValueRange RangeAnalysis::before(size_t index, const std::string& var) const {
+    int block = cfg->blockOf[index];
+    RangeMap ranges = entry[block];
+    for (size_t i = cfg->blocks[block].first; i < index; ++i) applyRanges((*code)[i], ranges);
+    return operandRange(var, ranges);
+}
+
+ValueRange RangeAnalysis::atExit(int block, const std::string& var) const {
+    RangeMap ranges = entry[block];
+    runBlock(block, ranges);
+    return operandRange(var, ranges);
+}
+
+bool RangeAnalysis::alongEdge(int block, int succ, RangeMap& ranges) const {
+    ranges = entry[block];
+    runBlock(block, ranges);
+    return refineEdge(block, succ, ranges);
+}
+
+bool RangeAnalysis::enteringLoop(const Loop& loop, RangeMap& ranges) const {
+    // The header of block 0 is also entered by starting the program
+    bool any = loop.header == 0;
+    if (any) ranges = entry[0];
+    for (int pred : cfg->blocks[loop.header].preds) {
+        RangeMap along;
+        if (loop.contains(pred) || !reachedBlock[pred] || !alongEdge(pred, loop.header, along)) continue;
+        ranges = any ? hull(ranges, along) : along;
+        any = true;
+    }
+    return any;
+}
+
+bool RangeAnalysis::refineEdge(int block, int succ, RangeMap& ranges) const {
+    const BasicBlock& bb = cfg->blocks[block];
+    const Instr& test = (*code)[bb.last - 1];
+    if (test.kind != Instr::IF) return true;
+    auto target = cfg->labelBlock.find(test.label);
+    if (target == cfg->labelBlock.end()) return true;
+    if (bb.succs.size() == 2 && bb.succs[0] == bb.succs[1]) return true; // Same block either way
+    bool taken = target->second == succ;
+
+    ValueRange a = operandRange(test.a, ranges), b = operandRange(test.b, ranges);
+    if (!refine(taken ? test.op : invertComparison(test.op), a, b)) return false;
+
+    // The narrowed range also holds for the variable an operand was copied from
+    auto narrow = [&](const std::string& operand, const ValueRange& range) {
+        if (!isVariable(operand)) return;
+        setRange(ranges, operand, range);
+        for (size_t i = bb.last - 1; i-- > bb.first;) {
+            const Instr& instr = (*code)[i];
+            if (instr.kind != Instr::ASSIGN || instr.dst != operand) continue;
+            if (!instr.op.empty() || !isVariable(instr.a)) return;
+            for (size_t k = i + 1; k + 1 < bb.last; ++k) {
+                if ((*code)[k].kind == Instr::ASSIGN && (*code)[k].dst == instr.a) return;
+            }
+            ValueRange source = operandRange(instr.a, ranges);
+            setRange(ranges, instr.a, ValueRange::of(std::max(source.lo, range.lo), std::min(source.hi, range.hi)));
+            return;
+        }
+    };
+    narrow(test.a, a);
+    narrow(test.b, b);
+    return true;
+}
+
+void RangeAnalysis::compute(const std::vector<Instr>& program, const ControlFlowGraph& graph) {
+    code = &program;
+    cfg = &graph;
+    size_t blockCount = graph.blocks.size();
+    entry.assign(blockCount, RangeMap());
+    reachedBlock.assign(blockCount, 0);
+    if (blockCount == 0) return;
+
+    // --- Fixpoint with widening ---
+    std::vector<int> changes(blockCount, 0);
+    std::vector<char> queued(blockCount, 0);
+    std::deque<int> worklist;
+    reachedBlock[0] = 1;
+    worklist.push_back(0);
+    queued[0] = 1;
+    while (!worklist.empty()) {
+        int b = worklist.front();
+        worklist.pop_front();
+        queued[b] = 0;
+
+        RangeMap exit = entry[b];
+        runBlock(b, exit);
+        const std::vector<int>& succs = graph.blocks[b].succs;
+        for (size_t k = 0; k < succs.size(); ++k) {
+            int succ = succs[k];
+            if (k > 0 && succ == succs[0]) continue;
+            RangeMap along = exit;
+            if (!refineEdge(b, succ, along)) continue;
+
+            if (!reachedBlock[succ]) {
+                reachedBlock[succ] = 1;
+                entry[succ] = std::move(along);
+            } else {
+                RangeMap joined = hull(entry[succ], along);
+                if (sameRanges(joined, entry[succ])) continue;
+                if (++changes[succ] > WIDEN_AFTER) {
+                    for (auto& range : joined) {
+                        const ValueRange& old = entry[succ].at(range.first);
+                        if (range.second.lo < old.lo) range.second.lo = widenDown(range.second.lo);
+                        if (range.second.hi > old.hi) range.second.hi = widenUp(range.second.hi);
+                    }
+                    for (auto it = joined.begin(); it != joined.end();) {
+                        it = it->second.isFull() ? joined.erase(it) : std::next(it);
+                    }
+                }
+                entry[succ] = std::move(joined);
+            }
+            if (!queued[succ]) {
+                queued[succ] = 1;
+                worklist.push_back(succ);
+            }
+        }
+    }
+
+    // --- Narrowing: recompute each entry from its predecessors ---
+    for (int round = 0; round < NARROW_ROUNDS; ++round) {
+        for (size_t b = 1; b < blockCount; ++b) {
+            if (!reachedBlock[b]) continue;
+            bool any = false;
+            RangeMap joined;
+            for (int pred : graph.blocks[b].preds) {
+                RangeMap along;
+                if (!reachedBlock[pred] || !alongEdge(pred, static_cast<int>(b), along)) continue;
+                joined = any ? hull(joined, along) : along;
+                any = true;
+            }
+            if (any) entry[b] = std::move(joined);
+        }
+    }
+}
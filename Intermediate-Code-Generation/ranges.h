@@ -0,0 +1,76 @@
+#ifndef RANGES_H
+#define RANGES_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "ir.h"
+#include "const_fold.h"
+
+// The values a variable can hold: lo <= value <= hi, within the SPL integer
+// range. The full range stands for "unknown".
+struct ValueRange {
+    long long lo = SPL_INT_MIN;
+    long long hi = SPL_INT_MAX;
+
+    static ValueRange of(long long lo, long long hi);
+    static ValueRange constant(long long value) { return of(value, value); }
+    bool isFull() const { return lo == SPL_INT_MIN && hi == SPL_INT_MAX; }
+    bool isConstant() const { return lo == hi; }
+    bool contains(long long value) const { return lo <= value && value <= hi; }
+};
+
+// Ranges at a program point: variable -> range. Variables that are not in the
+// map can hold anything.
+typedef std::unordered_map<std::string, ValueRange> RangeMap;
+
+bool isComparison(const std::string& op); // = <> < > <= >=
+ValueRange operandRange(const std::string& operand, const RangeMap& ranges);
+// Applies an instruction to the ranges before it (only assignments change them)
+void applyRanges(const Instr& instr, RangeMap& ranges);
+// 1 if "a op b" holds for all values in the ranges, 0 if for none, -1 otherwise
+int compareRanges(const ValueRange& a, const std::string& op, const ValueRange& b);
+// Narrows the operands' ranges to the values for which "a op b" holds. False
+// if there are none.
+bool narrowRanges(const std::string& a, const std::string& op, const std::string& b, RangeMap& ranges);
+
+/**
+ * @brief Interval analysis of the values variables hold.
+ * A forward dataflow over the CFG: assignments compute the range of their
+ * result from the ranges of the operands (anything that could leave the SPL
+ * integer range is unknown), and each edge out of an IF narrows its operands
+ * to the values for which the IF goes that way. Edges that no value can take
+ * are not followed, so code behind them is never reached. Blocks in cycles
+ * widen their bounds to the ends of the integer range after a few rounds, and
+ * two passes of narrowing afterwards win back bounds that loop tests impose.
+ * Queries are valid as long as the code and CFG it was computed on are.
+ */
+class RangeAnalysis {
+public:
+    void compute(const std::vector<Instr>& code, const ControlFlowGraph& cfg);
+
+    bool reached(int block) const { return reachedBlock[block] != 0; }
+    const RangeMap& atEntry(int block) const { return entry[block]; }
+    // Range of var just before the instruction at index runs
+    ValueRange before(size_t index, const std::string& var) const;
+    // Range of var once the block has run (before its IF takes either way)
+    ValueRange atExit(int block, const std::string& var) const;
+    // Ranges along the edge from a block to one of its successors. False if
+    // no execution takes that edge.
+    bool alongEdge(int block, int succ, RangeMap& ranges) const;
+    // Ranges on entry to a loop's header from outside the loop, those its
+    // first trip starts with. False if the loop is never entered.
+    bool enteringLoop(const Loop& loop, RangeMap& ranges) const;
+
+private:
+    const std::vector<Instr>* code = nullptr;
+    const ControlFlowGraph* cfg = nullptr;
+    std::vector<RangeMap> entry;
+    std::vector<char> reachedBlock;
+
+    void runBlock(int block, RangeMap& ranges) const;
+    // Narrows the ranges at the end of a block to those that take the edge to succ
+    bool refineEdge(int block, int succ, RangeMap& ranges) const;
+};
+
+#endif // RANGES_H
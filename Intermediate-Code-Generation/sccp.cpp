@@ -0,0 +1,234 @@
+#include "optimizer.h"
+#include "const_fold.h"
+#include <deque>
+
+// =================== Lattice Helpers ===================
+
+static bool operandValue(const std::string& operand, const ConstMap& consts, long long& value) {
+    if (literalValue(operand, value)) return true;
+    auto it = consts.find(operand);
+    if (it == consts.end()) return false;
+    value = it->second;
+    return true;
+}
+
+// The value an assignment stores, if it is a compile-time constant
+static bool evalAssign(const Instr& instr, const ConstMap& consts, long long& value) {
+    long long a, b;
+    if (!operandValue(instr.a, consts, a)) return false;
+    if (instr.op.empty()) {
+        value = a;
+        return true;
+    }
+    if (instr.b.empty()) { // Negation
+        if (a == SPL_INT_MIN) return false;
+        value = -a;
+        return true;
+    }
+    return operandValue(instr.b, consts, b) && evalBasicBinary(instr.op, a, b, value);
+}
+
+// x * 0 is 0 whatever x holds
+static bool isZeroProduct(const Instr& instr, const ConstMap& consts) {
+    long long value;
+    if (instr.op != "*") return false;
+    return (operandValue(instr.a, consts, value) && value == 0) || (operandValue(instr.b, consts, value) && value == 0);
+}
+
+// Rewrites x + 0, 0 + x, x - 0, x * 1 and 1 * x as a copy of x
+static void simplifyIdentity(Instr& instr) {
+    long long a, b;
+    bool hasA = literalValue(instr.a, a), hasB = !instr.b.empty() && literalValue(instr.b, b);
+    std::string kept;
+    if ((instr.op == "+" || instr.op == "-") && hasB && b == 0) kept = instr.a;
+    else if (instr.op == "+" && hasA && a == 0) kept = instr.b;
+    else if (instr.op == "*" && hasB && b == 1) kept = instr.a;
+    else if (instr.op == "*" && hasA && a == 1) kept = instr.b;
+    else return;
+    instr.op = "";
+    instr.a = kept;
+    instr.b = "";
+}
+
+// 1 if the IF jumps, 0 if it falls through, -1 if that depends on run-time values
+static int branchOutcome(const Instr& instr, const ConstMap& consts) {
+    long long a, b, value;
+    if (operandValue(instr.a, consts, a) && operandValue(instr.b, consts, b) &&
+        evalBasicBinary(instr.op, a, b, value)) {
+        return value != 0 ? 1 : 0;
+    }
+    return -1;
+}
+
+static void transfer(const Instr& instr, ConstMap& consts) {
+    if (instr.kind == Instr::ASSIGN) {
+        long long value;
+        if (evalAssign(instr, consts, value)) consts[instr.dst] = value;
+        else if (isZeroProduct(instr, consts)) consts[instr.dst] = 0;
+        else consts.erase(instr.dst);
+    }
+    else if (instr.kind == Instr::OTHER) {
+        consts.clear(); // Unknown line: assume it may write anything
+    }
+}
+
+// Keeps only the constants both paths agree on
+static void meet(ConstMap& into, const ConstMap& other) {
+    for (auto it = into.begin(); it != into.end();) {
+        auto found = other.find(it->first);
+        if (found == other.end() || found->second != it->second) it = into.erase(it);
+        else ++it;
+    }
+}
+
+static void substitute(std::string& operand, const ConstMap& consts) {
+    auto it = consts.find(operand);
+    if (it != consts.end()) operand = std::to_string(it->second);
+}
+
+// =================== Pass ===================
+
+/**
+ * @brief Conditional constant propagation over the CFG (Wegman-Zadeck).
+ * Blocks are only visited once an edge into them is known to be executable, and
+ * an IF whose operands are constant marks just the edge it takes. Values that
+ * reach a block are met over its executable in-edges only, so constants survive
+ * branches and loops that are never taken. Afterwards uses of constants are
+ * replaced by literals, decided IFs become a GOTO or disappear, assignments of
+ * the value a variable already holds are deleted, and blocks that were never
+ * reached are deleted along with their REM labels.
+ */
+bool Optimizer::propagateConstants() {
+    ControlFlowGraph cfg;
+    cfg.build(program);
+    size_t blockCount = cfg.blocks.size();
+    if (blockCount == 0) return false;
+
+    std::vector<char> visited(blockCount, 0);
+    std::vector<ConstMap> inState(blockCount), outState(blockCount);
+    std::vector<std::vector<char>> executable(blockCount);
+    for (size_t b = 0; b < blockCount; ++b) {
+        executable[b].assign(cfg.blocks[b].succs.size(), 0);
+    }
+
+    std::deque<int> worklist;
+    std::vector<char> queued(blockCount, 0);
+    auto enqueue = [&](int b) {
+        if (!queued[b]) {
+            queued[b] = 1;
+            worklist.push_back(b);
+        }
+    };
+    enqueue(0);
+
+    while (!worklist.empty()) {
+        int b = worklist.front();
+        worklist.pop_front();
+        queued[b] = 0;
+        const BasicBlock& block = cfg.blocks[b];
+
+        // Nothing is known about any variable on entry to the program
+        ConstMap state;
+        if (b != 0) {
+            bool first = true;
+            for (int pred : block.preds) {
+                const auto& succs = cfg.blocks[pred].succs;
+                for (size_t k = 0; k < succs.size(); ++k) {
+                    if (succs[k] != b || !executable[pred][k]) continue;
+                    if (first) state = outState[pred];
+                    else meet(state, outState[pred]);
+                    first = false;
+                }
+            }
+        }
+        inState[b] = state;
+
+        for (size_t i = block.first; i < block.last; ++i) {
+            transfer(program[i], state);
+        }
+        bool changed = !visited[b] || state != outState[b];
+        visited[b] = 1;
+        outState[b] = std::move(state);
+
+        // Which out-edges can be taken
+        const Instr& tail = program[block.last - 1];
+        int outcome = (tail.kind == Instr::IF) ? branchOutcome(tail, outState[b]) : -1;
+        bool hasTarget = (tail.kind == Instr::IF) && cfg.labelBlock.count(tail.label);
+        for (size_t k = 0; k < block.succs.size(); ++k) {
+            bool isTarget = hasTarget && k == 0;
+            if (outcome == 1 && !isTarget) continue;
+            if (outcome == 0 && isTarget) continue;
+            if (!executable[b][k]) {
+                executable[b][k] = 1;
+                enqueue(block.succs[k]);
+            } else if (changed) {
+                enqueue(block.succs[k]);
+            }
+        }
+    }
+
+    // Rewrite using the constants that hold on entry to each block
+    bool changed = false;
+    std::vector<bool> deleted(program.size(), false);
+    for (size_t b = 0; b < blockCount; ++b) {
+        const BasicBlock& block = cfg.blocks[b];
+        if (!visited[b]) {
+            for (size_t i = block.first; i < block.last; ++i) deleted[i] = true;
+            changed = true;
+            continue;
+        }
+
+        ConstMap& state = inState[b];
+        for (size_t i = block.first; i < block.last; ++i) {
+            Instr& instr = program[i];
+            std::string before = renderInstr(instr);
+
+            if (instr.kind == Instr::ASSIGN) {
+                long long value;
+                bool constant = evalAssign(instr, state, value);
+                if (!constant && isZeroProduct(instr, state)) {
+                    value = 0;
+                    constant = true;
+                }
+                auto known = state.find(instr.dst);
+                if (constant && known != state.end() && known->second == value) {
+                    // The variable holds that value already
+                    deleted[i] = true;
+                    changed = true;
+                    continue;
+                }
+                if (constant) {
+                    instr.op = "";
+                    instr.a = std::to_string(value);
+                    instr.b = "";
+                } else {
+                    substitute(instr.a, state);
+                    substitute(instr.b, state);
+                    simplifyIdentity(instr);
+                }
+            }
+            else if (instr.kind == Instr::PRINT) {
+                substitute(instr.a, state);
+            }
+            else if (instr.kind == Instr::IF) {
+                int outcome = branchOutcome(instr, state);
+                if (outcome == 1) {
+                    instr.kind = Instr::GOTO;
+                } else if (outcome == 0) {
+                    deleted[i] = true;
+                    changed = true;
+                    continue;
+                } else {
+                    substitute(instr.a, state);
+                    substitute(instr.b, state);
+                }
+            }
+
+            if (renderInstr(instr) != before) changed = true;
+            transfer(instr, state);
+        }
+    }
+
+    if (changed) removeDeleted(deleted);
+    return changed;
+}
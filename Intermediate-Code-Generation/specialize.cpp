@@ -0,0 +1,102 @@
+#include "specialize.h"
+#include "ast_copy.h"
+#include "const_fold.h"
+
+// Largest body (in statements, nested ones included) worth a specialised copy
+static const size_t SPECIALIZE_MAX_SIZE = 100;
+// Specialised copies of one function
+static const int SPECIALIZE_MAX_VERSIONS = 8;
+
+// =================== Analysis ===================
+
+// Number of statements, and the variables some statement assigns
+static size_t scanStatements(const AstNodeList<StatementNode>* stmts, std::map<std::string, bool>& assigned) {
+    if (!stmts) return 0;
+    size_t count = 0;
+    for (auto* stmt : stmts->elements) {
+        ++count;
+        if (auto* assign = dynamic_cast<const AssignNode*>(stmt)) {
+            assigned[assign->var->name] = true;
+        }
+        else if (auto* ifNode = dynamic_cast<const IfNode*>(stmt)) {
+            count += scanStatements(ifNode->then_branch, assigned);
+        }
+        else if (auto* ifElse = dynamic_cast<const IfElseNode*>(stmt)) {
+            count += scanStatements(ifElse->then_branch, assigned);
+            count += scanStatements(ifElse->else_branch, assigned);
+        }
+        else if (auto* whileNode = dynamic_cast<const WhileNode*>(stmt)) {
+            count += scanStatements(whileNode->body, assigned);
+        }
+        else if (auto* doUntil = dynamic_cast<const DoUntilNode*>(stmt)) {
+            count += scanStatements(doUntil->body, assigned);
+        }
+    }
+    return count;
+}
+
+// =================== PUBLIC ===================
+
+void Specializer::clear() {
+    for (auto& version : versions) delete version.second;
+    versions.clear();
+    restart();
+}
+
+void Specializer::restart() {
+    chosen.clear();
+    versionsOf.clear();
+}
+
+void Specializer::forget(const BodyNode* body) {
+    auto it = versions.lower_bound({body, ""});
+    while (it != versions.end() && it->first.first == body) {
+        delete it->second;
+        chosen.erase(it->first);
+        it = versions.erase(it);
+    }
+}
+
+AstNodeList<StatementNode>* Specializer::bodyFor(const std::string& name, AstNodeList<VarNode>* params, BodyNode* body,
+                                                 const std::vector<std::string>& args, std::vector<bool>& constant) {
+    size_t paramCount = params ? params->elements.size() : 0;
+    constant.assign(paramCount, false);
+
+    // --- Which parameters become literals ---
+    std::map<std::string, bool> assigned;
+    size_t size = scanStatements(body->statements, assigned);
+    Substitution subst;
+    std::string key = name + "(";
+    for (size_t i = 0; i < paramCount; ++i) {
+        const std::string& param = params->elements[i]->name;
+        NumberNode literal(i < args.size() ? args[i] : "");
+        long long value;
+        if (constantValue(&literal, value) && !assigned.count(param)) {
+            subst[param] = literal.value;
+            key += literal.value;
+        } else {
+            key += "_";
+        }
+        key += i + 1 < paramCount ? "," : ")";
+    }
+    if (subst.empty() || size > SPECIALIZE_MAX_SIZE) return body->statements;
+
+    // --- The copy for these constants, made in this compile or an earlier one ---
+    Version version{body, key};
+    if (!chosen.count(version)) {
+        if (versionsOf[name] >= SPECIALIZE_MAX_VERSIONS) return body->statements;
+        ++versionsOf[name];
+        chosen.insert(version);
+    }
+    auto it = versions.find(version);
+    if (it == versions.end()) {
+        AstNodeList<StatementNode>* copy = copyStatements(body->statements, subst);
+        ConstantFolder folder;
+        folder.foldStatements(copy);
+        it = versions.insert({version, copy}).first;
+    }
+    for (size_t i = 0; i < paramCount; ++i) {
+        constant[i] = subst.count(params->elements[i]->name) > 0;
+    }
+    return it->second;
+}
@@ -0,0 +1,57 @@
+#ifndef SPECIALIZE_H
+#define SPECIALIZE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <utility>
+#include "../ast.h"
+
+/**
+ * @brief Specialisation of function and procedure bodies on constant arguments.
+ * Used by CodeGen::performInlining. For a call that passes literals, each
+ * parameter that receives one and is never assigned in the body is replaced
+ * by the literal in a copy of the body, and the copy goes through the
+ * ConstantFolder: branches on the parameter disappear before they are
+ * generated, together with any calls inside them. Every distinct combination
+ * of constant arguments gets one copy, shared by all calls that pass it.
+ * Bodies over SPECIALIZE_MAX_SIZE statements and calls beyond
+ * SPECIALIZE_MAX_VERSIONS copies of one function use the original body.
+ * Copies are kept per body until clear() or forget(), so a Specializer shared
+ * by successive compiles (see splc::Session) folds each only once; the limit
+ * counts the copies one compile uses.
+ */
+class Specializer {
+public:
+    Specializer() = default;
+    Specializer(const Specializer&) = delete;
+    Specializer& operator=(const Specializer&) = delete;
+    ~Specializer() { clear(); }
+
+    // Drops every copy
+    void clear();
+    // Starts another compile, whose bodies may be the ones earlier copies were
+    // made from: those are reused, and the limit counts afresh
+    void restart();
+    // Drops the copies made from body, before it is deleted
+    void forget(const BodyNode* body);
+
+    // The statements to inline for a call of name(args), where args are the
+    // generated operands (literals or variable names). constant[i] is set for
+    // each parameter the returned statements no longer refer to.
+    AstNodeList<StatementNode>* bodyFor(const std::string& name, AstNodeList<VarNode>* params, BodyNode* body,
+                                        const std::vector<std::string>& args, std::vector<bool>& constant);
+
+    // Copies the current compile used
+    int getVersionCount() const { return static_cast<int>(chosen.size()); }
+
+private:
+    typedef std::pair<const BodyNode*, std::string> Version; // Body and "name(5,_)"
+
+    std::map<Version, AstNodeList<StatementNode>*> versions; // Folded copies
+    std::set<Version> chosen;                                // Used by the current compile
+    std::map<std::string, int> versionsOf;                   // Function -> copies it used
+};
+
+#endif // SPECIALIZE_H
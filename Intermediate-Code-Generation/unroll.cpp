@@ -0,0 +1,141 @@
+#include "optimizer.h"
+#include "induction.h"
+#include "ranges.h"
+#include "const_fold.h"
+#include <algorithm>
+
+// Largest amount of code (in instructions) a loop may unroll into
+static const size_t UNROLL_MAX_SIZE = 48;
+// Trips per iteration of a partially unrolled loop
+static const long long UNROLL_FACTOR = 4;
+
+// The value var has on every edge into the loop, if the ranges pin it down
+static bool valueOnEntry(const RangeAnalysis& ranges, const ControlFlowGraph& cfg, const Loop& loop,
+                         const std::string& var, long long& value) {
+    if (loop.header == 0) return false; // Also entered at program start
+    bool found = false;
+    for (int pred : cfg.blocks[loop.header].preds) {
+        RangeMap along;
+        if (loop.contains(pred) || !ranges.reached(pred) || !ranges.alongEdge(pred, loop.header, along)) continue;
+        ValueRange range = operandRange(var, along);
+        if (!range.isConstant() || (found && range.lo != value)) return false;
+        value = range.lo;
+        found = true;
+    }
+    return found;
+}
+
+/**
+ * @brief Unrolling of loops with a trip count known at compile time.
+ * The counted loops of induction.h whose counter enters with a single value
+ * and runs to a bound RangeAnalysis knows exactly lose their test and back
+ * edge entirely when the whole run fits in UNROLL_MAX_SIZE instructions. Longer ones run UNROLL_FACTOR
+ * trips per test: the trips that do not divide evenly are peeled in front,
+ * after which the test is only ever reached on a multiple of the factor. The
+ * pass stops once the program has grown by half.
+ */
+bool Optimizer::unrollLoops() {
+    size_t budget = std::max(program.size() / 2, UNROLL_MAX_SIZE);
+    bool changedAny = false;
+
+    for (size_t round = 0; round < program.size(); ++round) {
+        ControlFlowGraph cfg;
+        cfg.build(program);
+        if (cfg.blocks.empty()) break;
+        DominatorTree dom;
+        dom.build(cfg);
+        std::vector<Loop> loops = findLoops(cfg, dom);
+        RangeAnalysis ranges;
+        ranges.compute(program, cfg);
+
+        bool changed = false;
+        for (const Loop& loop : loops) {
+            CountedLoop counted;
+            if (!analyzeCountedLoop(program, cfg, loop, counted)) continue;
+            const BasicBlock& header = cfg.blocks[loop.header];
+            if (program[header.first].kind != Instr::LABEL) continue;
+
+            // --- Trip count: counter value at the first test, constant bound ---
+            long long bound, start = 0, trips;
+            ValueRange boundRange = operandRange(counted.bound, ranges.atEntry(loop.header));
+            if (!ranges.reached(loop.header) || !boundRange.isConstant()) continue;
+            bound = boundRange.lo;
+            // The instructions before the test may move the counter or set it outright
+            AffineState entryState;
+            runAffine(program, counted.entry, entryState);
+            auto it = entryState.find(counted.counter);
+            const Affine* entryEffect = it == entryState.end() ? nullptr : &it->second;
+            if (entryEffect && (!entryEffect->known || !(entryEffect->isConstant() ||
+                    (entryEffect->terms.size() == 1 && entryEffect->coefficient(counted.counter) == 1)))) {
+                continue;
+            }
+            if (!entryEffect || !entryEffect->isConstant()) {
+                if (!valueOnEntry(ranges, cfg, loop, counted.counter, start)) continue;
+            }
+            if (entryEffect) {
+                start = (entryEffect->isConstant() ? 0 : start) + entryEffect->constant;
+                if (start < SPL_INT_MIN || start > SPL_INT_MAX) continue;
+            }
+            if (!tripCount(counted, start, bound, trips)) continue;
+
+            size_t tripSize = counted.trip.size();
+            long long factor = 0; // 0: unroll completely
+            if (static_cast<unsigned long long>(trips) * tripSize > std::min(UNROLL_MAX_SIZE, budget)) {
+                factor = UNROLL_FACTOR;
+                size_t peeled = static_cast<size_t>(trips % factor);
+                if (trips < factor || (factor + peeled) * tripSize > std::min(UNROLL_MAX_SIZE, budget)) continue;
+            }
+
+            // --- The replacement, at the header ---
+            const BasicBlock& exit = cfg.blocks[counted.exitBlock];
+            bool newExitLabel = program[exit.first].kind != Instr::LABEL;
+            std::string exitLabel = newExitLabel ? newLabel("LBL_EXIT") : program[exit.first].label;
+            auto appendTrips = [&](std::vector<Instr>& code, long long count) {
+                for (long long n = 0; n < count; ++n) {
+                    for (size_t i : counted.trip) code.push_back(program[i]);
+                }
+            };
+
+            std::vector<Instr> code;
+            code.push_back(program[header.first]);
+            for (size_t i : counted.entry) code.push_back(program[i]);
+            if (factor == 0) {
+                appendTrips(code, trips);
+                code.push_back(makeGoto(exitLabel));
+            } else {
+                appendTrips(code, trips % factor);
+                const std::string& headerLabel = program[header.first].label;
+                std::string top = newLabel(headerLabel.substr(0, headerLabel.rfind('_')));
+                Instr test;
+                test.kind = Instr::IF;
+                test.a = counted.counter;
+                test.op = invertComparison(counted.cmp);
+                test.b = std::to_string(bound);
+                test.label = exitLabel;
+                code.push_back(makeLabel(top));
+                code.push_back(test);
+                appendTrips(code, factor);
+                code.push_back(makeGoto(top));
+            }
+
+            size_t loopSize = 0;
+            for (int b : loop.blocks) loopSize += cfg.blocks[b].last - cfg.blocks[b].first;
+            std::vector<Instr> result;
+            result.reserve(program.size() + code.size());
+            for (size_t i = 0; i < program.size(); ++i) {
+                if (i == header.first) result.insert(result.end(), code.begin(), code.end());
+                if (i == exit.first && newExitLabel) result.push_back(makeLabel(exitLabel));
+                if (!loop.contains(cfg.blockOf[i])) result.push_back(program[i]);
+            }
+            program = std::move(result);
+
+            if (code.size() > loopSize) budget -= std::min(budget, code.size() - loopSize);
+            ++(factor == 0 ? stats.loopsUnrolled : stats.loopsUnrolledPartially);
+            changed = true;
+            break;
+        }
+        if (!changed) break;
+        changedAny = true;
+    }
+    return changedAny;
+}
@@ -0,0 +1,137 @@
+#include "optimizer.h"
+#include <algorithm>
+
+// Largest loop (in instructions) worth a second copy
+static const size_t UNSWITCH_MAX_LOOP = 60;
+
+/**
+ * @brief Loop unswitching.
+ * An IF inside a loop whose operands the loop never assigns takes the same
+ * branch on every iteration. The loop is copied: the original becomes the
+ * version where the IF falls through (the IF is deleted), the copy is the
+ * version where it jumps (the IF becomes a GOTO). A single test of the
+ * condition in the preheader picks the version. The copy gets fresh labels,
+ * is placed after the end of the program, and jumps back to wherever the loop
+ * exits. Only loops of at most UNSWITCH_MAX_LOOP instructions are copied, and
+ * the pass stops once the program has grown by half.
+ */
+bool Optimizer::unswitchLoops() {
+    size_t budget = std::max(program.size() / 2, UNSWITCH_MAX_LOOP);
+    bool changedAny = false;
+
+    while (true) {
+        ControlFlowGraph cfg;
+        cfg.build(program);
+        if (cfg.blocks.empty()) break;
+        DominatorTree dom;
+        dom.build(cfg);
+        std::vector<Loop> loops = findLoops(cfg, dom);
+        VariableIndex vars;
+        for (const auto& instr : program) {
+            if (instr.kind == Instr::ASSIGN) vars.id(instr.dst);
+        }
+
+        bool changed = false;
+        for (const Loop& loop : loops) {
+            size_t size = 0;
+            for (int b : loop.blocks) size += cfg.blocks[b].last - cfg.blocks[b].first;
+            if (size > UNSWITCH_MAX_LOOP || size > budget || !hasPreheaderSlot(cfg, loop)) continue;
+
+            std::vector<char> assigned(vars.names.size(), 0);
+            bool runsOffEnd = false;
+            for (int b : loop.blocks) {
+                for (size_t i = cfg.blocks[b].first; i < cfg.blocks[b].last; ++i) {
+                    if (program[i].kind == Instr::ASSIGN) assigned[vars.id(program[i].dst)] = 1;
+                }
+                Instr::Kind kind = program[cfg.blocks[b].last - 1].kind;
+                if (b + 1 == static_cast<int>(cfg.blocks.size()) && kind != Instr::GOTO && kind != Instr::STOP) {
+                    runsOffEnd = true;
+                }
+            }
+            if (runsOffEnd) continue;
+
+            // --- An IF that stays in the loop either way and tests invariants ---
+            size_t branch = program.size();
+            for (int b : loop.blocks) {
+                const BasicBlock& block = cfg.blocks[b];
+                const Instr& tail = program[block.last - 1];
+                if (tail.kind != Instr::IF || block.succs.size() != 2) continue;
+                if (!loop.contains(block.succs[0]) || !loop.contains(block.succs[1])) continue;
+                bool invariant = true;
+                for (const auto& name : instrUses(tail)) {
+                    int v = vars.find(name);
+                    if (v != -1 && assigned[v]) invariant = false;
+                }
+                if (invariant) {
+                    branch = block.last - 1;
+                    break;
+                }
+            }
+            if (branch == program.size()) continue;
+
+            // --- The copy where the IF always jumps ---
+            std::unordered_map<std::string, std::string> renamed;
+            for (int b : loop.blocks) {
+                for (size_t i = cfg.blocks[b].first; i < cfg.blocks[b].last; ++i) {
+                    if (program[i].kind != Instr::LABEL) continue;
+                    const std::string& label = program[i].label;
+                    renamed[label] = newLabel(label.substr(0, label.rfind('_')));
+                }
+            }
+            // Blocks the loop falls out into need a label the copy can jump to
+            std::unordered_map<size_t, std::string> newLabels; // Instruction index -> label to put before it
+            auto labelOfBlock = [&](int b) {
+                size_t first = cfg.blocks[b].first;
+                if (program[first].kind == Instr::LABEL) return program[first].label;
+                auto it = newLabels.find(first);
+                if (it == newLabels.end()) it = newLabels.insert({first, newLabel("LBL_EXIT")}).first;
+                return it->second;
+            };
+
+            std::vector<Instr> copy;
+            for (int b : loop.blocks) {
+                const BasicBlock& block = cfg.blocks[b];
+                for (size_t i = block.first; i < block.last; ++i) {
+                    Instr instr = program[i];
+                    if (i == branch) instr = makeGoto(instr.label);
+                    auto it = renamed.find(instr.label);
+                    if (it != renamed.end()) instr.label = it->second;
+                    copy.push_back(instr);
+                }
+                Instr::Kind kind = copy.back().kind;
+                int next = b + 1;
+                if (kind != Instr::GOTO && kind != Instr::STOP && !loop.contains(next)) {
+                    copy.push_back(makeGoto(labelOfBlock(next)));
+                }
+            }
+
+            // --- Preheader test, then the original loop without the IF ---
+            const BasicBlock& header = cfg.blocks[loop.header];
+            Instr test = program[branch];
+            test.label = renamed[program[header.first].label];
+            std::string preheaderLabel = redirectLoopEntries(cfg, loop);
+
+            std::vector<Instr> result;
+            result.reserve(program.size() + copy.size() + 4);
+            for (size_t i = 0; i < program.size(); ++i) {
+                if (i == header.first) {
+                    if (!preheaderLabel.empty()) result.push_back(makeLabel(preheaderLabel));
+                    result.push_back(test);
+                }
+                auto it = newLabels.find(i);
+                if (it != newLabels.end()) result.push_back(makeLabel(it->second));
+                if (i != branch) result.push_back(program[i]);
+            }
+            appendDetached(result, copy);
+
+            budget -= std::min(budget, copy.size());
+            program = std::move(result);
+            ++stats.loopsUnswitched;
+            changed = true;
+            break;
+        }
+        if (!changed) break;
+        changedAny = true;
+    }
+    return changedAny;
+}
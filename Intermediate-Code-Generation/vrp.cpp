@@ -0,0 +1,48 @@
+#include "optimizer.h"
+#include "ranges.h"
+
+/**
+ * @brief Comparison folding with value ranges.
+ * Where the ranges of RangeAnalysis decide a comparison (a counter that
+ * starts at 1 and only grows is never <= 0; a value an enclosing IF already
+ * tested against a constant), an IF becomes a GOTO or disappears, and a
+ * comparison stored in a variable becomes its truth value. The code the
+ * branches no longer reach is left to dead code elimination.
+ */
+bool Optimizer::foldComparisons() {
+    ControlFlowGraph cfg;
+    cfg.build(program);
+    if (cfg.blocks.empty()) return false;
+    RangeAnalysis ranges;
+    ranges.compute(program, cfg);
+
+    std::vector<bool> deleted(program.size(), false);
+    bool changed = false;
+    for (size_t b = 0; b < cfg.blocks.size(); ++b) {
+        if (!ranges.reached(static_cast<int>(b))) continue;
+        RangeMap state = ranges.atEntry(static_cast<int>(b));
+        for (size_t i = cfg.blocks[b].first; i < cfg.blocks[b].last; ++i) {
+            Instr& instr = program[i];
+            if (instr.kind == Instr::IF) {
+                int outcome = compareRanges(operandRange(instr.a, state), instr.op, operandRange(instr.b, state));
+                if (outcome == 1) instr = makeGoto(instr.label);
+                if (outcome == 0) deleted[i] = true;
+                if (outcome != -1) {
+                    ++stats.comparisonsFolded;
+                    changed = true;
+                }
+            }
+            else if (instr.kind == Instr::ASSIGN && isComparison(instr.op)) {
+                int outcome = compareRanges(operandRange(instr.a, state), instr.op, operandRange(instr.b, state));
+                if (outcome != -1) {
+                    instr = makeCopy(instr.dst, outcome ? "-1" : "0");
+                    ++stats.comparisonsFolded;
+                    changed = true;
+                }
+            }
+            applyRanges(instr, state);
+        }
+    }
+    if (changed) removeDeleted(deleted);
+    return changed;
+}
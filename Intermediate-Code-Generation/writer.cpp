@@ -0,0 +1,113 @@
+#include "writer.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <climits>
+
+// Size of the blocks small writes are gathered in
+static const size_t WRITER_BLOCK_SIZE = 1 << 20;
+
+// =================== PUBLIC ===================
+
+OutputWriter::OutputWriter(const std::string& path) {
+    if (path == "-") {
+        fd = STDOUT_FILENO;
+        return;
+    }
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ownsFd = fd >= 0;
+}
+
+void OutputWriter::write(const char* text, size_t size) {
+    if (size == 0) return;
+    // Large pieces become blocks of their own rather than being copied around
+    if (size >= WRITER_BLOCK_SIZE) {
+        adopt(std::string(text, size));
+        return;
+    }
+    std::string* block = &openBlock();
+    if (block->size() + size > WRITER_BLOCK_SIZE) {
+        lastOpen = false;
+        block = &openBlock();
+    }
+    block->append(text, size);
+}
+
+void OutputWriter::writeLine(const std::string& text) {
+    std::string& block = openBlock();
+    if (block.size() + text.size() + 1 > WRITER_BLOCK_SIZE) {
+        write(text);
+        write("\n", 1);
+        return;
+    }
+    block += text;
+    block += '\n';
+}
+
+void OutputWriter::adopt(std::string&& buffer) {
+    if (buffer.empty()) return;
+    blocks.push_back(std::move(buffer));
+    lastOpen = false;
+}
+
+bool OutputWriter::close() {
+    if (inMemory || fd < 0) return !failed;
+
+    // One writev for all the blocks, repeated only for what a partial write
+    // or the IOV_MAX limit left over
+    size_t next = 0;   // First block not completely written
+    size_t offset = 0; // Bytes of it already written
+    while (next < blocks.size() && !failed) {
+        std::vector<struct iovec> iov;
+        for (size_t b = next; b < blocks.size() && iov.size() < IOV_MAX; ++b) {
+            size_t skip = (b == next) ? offset : 0;
+            iov.push_back({const_cast<char*>(blocks[b].data()) + skip, blocks[b].size() - skip});
+        }
+        ssize_t written = ::writev(fd, iov.data(), static_cast<int>(iov.size()));
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            failed = true;
+            break;
+        }
+        size_t left = static_cast<size_t>(written);
+        while (next < blocks.size() && left >= blocks[next].size() - offset) {
+            left -= blocks[next].size() - offset;
+            offset = 0;
+            ++next;
+        }
+        offset += left;
+    }
+    blocks.clear();
+    lastOpen = false;
+
+    if (ownsFd && ::close(fd) != 0) failed = true;
+    fd = -1;
+    return !failed;
+}
+
+std::string OutputWriter::release() {
+    size_t size = 0;
+    for (const auto& block : blocks) size += block.size();
+    std::string text;
+    if (blocks.size() == 1) {
+        text = std::move(blocks.front());
+    } else {
+        text.reserve(size);
+        for (const auto& block : blocks) text += block;
+    }
+    blocks.clear();
+    lastOpen = false;
+    return text;
+}
+
+// =================== PRIVATE ===================
+
+std::string& OutputWriter::openBlock() {
+    if (!lastOpen) {
+        blocks.emplace_back();
+        blocks.back().reserve(WRITER_BLOCK_SIZE);
+        lastOpen = true;
+    }
+    return blocks.back();
+}
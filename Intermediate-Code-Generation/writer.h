@@ -0,0 +1,47 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief Buffered output for the generated files.
+ * Text is gathered in memory, in large blocks and in whole buffers handed
+ * over with adopt(), and goes to the file in one writev when the writer is
+ * closed: no flush and no system call per line. The path "-" is stdout.
+ * A writer made without a path keeps the text in memory for release().
+ */
+class OutputWriter {
+public:
+    OutputWriter() : inMemory(true) {}
+    explicit OutputWriter(const std::string& path);
+    OutputWriter(const OutputWriter&) = delete;
+    OutputWriter& operator=(const OutputWriter&) = delete;
+    ~OutputWriter() { close(); }
+
+    bool isOpen() const { return inMemory || fd >= 0; }
+
+    void write(const char* text, size_t size);
+    void write(const std::string& text) { write(text.data(), text.size()); }
+    // Writes text followed by a newline
+    void writeLine(const std::string& text);
+    // Takes over a buffer rendered elsewhere, without copying it
+    void adopt(std::string&& buffer);
+
+    // Writes everything gathered; returns false if the output could not be written
+    bool close();
+    // The text gathered by an in-memory writer, which starts over empty
+    std::string release();
+
+private:
+    bool inMemory = false;
+    int fd = -1;
+    bool ownsFd = false;
+    bool failed = false;
+    std::vector<std::string> blocks; // In output order; the last one is still being filled
+    bool lastOpen = false;           // The last block takes more small writes
+
+    std::string& openBlock();
+};
+
+#endif // WRITER_H
@@ -19,13 +19,17 @@ static const std::regex IDENT_REGEX("^[a-z][a-z0-9]*$");
 static const std::regex NUMBER_REGEX("^(0|[1-9][0-9]*)$");
 static const std::regex STRING_REGEX("^[A-Za-z0-9]{0,15}$");
 
+// Where the parser and the name checks report problems. The compiler library
+// points it at a buffer while it compiles.
+inline std::ostream* frontEndDiagnostics = &std::cerr;
+
 inline bool checkIdentifier(const std::string& name) {
     if (RESERVED_KEYWORDS.count(name)) {
-        std::cerr << "Invalid identifier: '" << name << "' is a reserved keyword." << std::endl;
+        *frontEndDiagnostics << "Invalid identifier: '" << name << "' is a reserved keyword." << std::endl;
         return false;
     }
     if (!std::regex_match(name, IDENT_REGEX)) {
-        std::cerr << "Invalid identifier: '" << name << "'. Must match [a-z][a-z0-9]*" << std::endl;
+        *frontEndDiagnostics << "Invalid identifier: '" << name << "'. Must match [a-z][a-z0-9]*" << std::endl;
         return false;
     }
     return true;
@@ -33,7 +37,7 @@ inline bool checkIdentifier(const std::string& name) {
 
 inline bool checkNumber(const std::string& value) {
     if (!std::regex_match(value, NUMBER_REGEX)) {
-        std::cerr << "Invalid number constant: '" << value << "'" << std::endl;
+        *frontEndDiagnostics << "Invalid number constant: '" << value << "'" << std::endl;
         return false;
     }
     return true;
@@ -41,11 +45,11 @@ inline bool checkNumber(const std::string& value) {
 
 inline bool checkString(const std::string& value) {
     if (value.length() > 15) {
-        std::cerr << "String literal exceeds 15 characters: '" << value << "'" << std::endl;
+        *frontEndDiagnostics << "String literal exceeds 15 characters: '" << value << "'" << std::endl;
         return false;
     }
     if (!std::regex_match(value, STRING_REGEX)) {
-        std::cerr << "Invalid string literal: '" << value << "'. Only letters/digits allowed." << std::endl;
+        *frontEndDiagnostics << "Invalid string literal: '" << value << "'. Only letters/digits allowed." << std::endl;
         return false;
     }
     return true;
@@ -144,6 +148,21 @@ public:
     }
 };
 
+// Never produced by the parser: the constant folder uses it for
+// boolean terms whose outcome is known at compile time.
+class BoolNode : public ExpressionNode {
+public:
+    bool value;
+    BoolNode(bool value) : value(value) {}
+    void print(int indent = 0) const override {
+        print_indent(indent);
+        std::cout << "Bool(" << (value ? "true" : "false") << ")" << std::endl;
+    }
+
+    void checkNames() const override {
+    }
+};
+
 class UnaryOpNode : public ExpressionNode {
 public:
     std::string op;
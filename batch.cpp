@@ -0,0 +1,233 @@
+#include "batch.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include "Intermediate-Code-Generation/writer.h"
+
+// Sources the reader may load beyond the inputs already compiled, per worker
+static const size_t READ_AHEAD_PER_WORKER = 4;
+
+// =================== Work-stealing pool ===================
+
+/**
+ * Jobs are dealt round-robin to one deque per worker. A worker takes the
+ * lowest job of its own deque; once that is empty it steals the highest job
+ * of another worker's, so the inputs are still taken roughly in order.
+ */
+class WorkStealingPool {
+public:
+    WorkStealingPool(size_t jobs, size_t workers) : queues(workers) {
+        for (size_t job = 0; job < jobs; ++job) queues[job % workers].jobs.push_back(job);
+    }
+
+    // Runs work(job) for every job, on one thread per worker
+    template <typename Work>
+    void run(Work work) {
+        std::vector<std::thread> threads;
+        for (size_t w = 0; w < queues.size(); ++w) {
+            threads.emplace_back([this, w, &work] {
+                size_t job;
+                while (take(w, job)) work(job);
+            });
+        }
+        for (auto& thread : threads) thread.join();
+    }
+
+private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<size_t> jobs;
+    };
+    std::vector<Queue> queues;
+
+    bool take(size_t worker, size_t& job) {
+        {
+            std::lock_guard<std::mutex> guard(queues[worker].lock);
+            if (!queues[worker].jobs.empty()) {
+                job = queues[worker].jobs.front();
+                queues[worker].jobs.pop_front();
+                return true;
+            }
+        }
+        for (size_t i = 1; i < queues.size(); ++i) {
+            Queue& victim = queues[(worker + i) % queues.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.jobs.empty()) {
+                job = victim.jobs.back();
+                victim.jobs.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// =================== Read-ahead ===================
+
+/**
+ * Loads the inputs in order on a thread of its own, at most `window` inputs
+ * beyond the number already compiled. Every job below the lowest unfinished
+ * one is done, so that job is always within the window: the workers cannot
+ * all end up waiting for sources the reader is not allowed to load.
+ */
+class InputReader {
+public:
+    InputReader(const std::vector<std::string>& paths, size_t window)
+        : paths(paths), window(window), sources(paths.size()), state(paths.size(), PENDING) {
+        thread = std::thread([this] { readAll(); });
+    }
+    ~InputReader() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        changed.notify_all();
+        thread.join();
+    }
+
+    // Waits for input i; returns false if it could not be read
+    bool take(size_t i, std::string& source) {
+        std::unique_lock<std::mutex> guard(lock);
+        changed.wait(guard, [&] { return state[i] != PENDING; });
+        source = std::move(sources[i]);
+        return state[i] == LOADED;
+    }
+
+    // Input i is compiled: the reader may go one further
+    void finished() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            ++done;
+        }
+        changed.notify_all();
+    }
+
+private:
+    enum State { PENDING, LOADED, UNREADABLE };
+
+    const std::vector<std::string>& paths;
+    const size_t window;
+    std::vector<std::string> sources;
+    std::vector<State> state;
+    size_t done = 0;
+    bool stopping = false;
+    std::mutex lock;
+    std::condition_variable changed;
+    std::thread thread;
+
+    void readAll() {
+        for (size_t i = 0; i < paths.size(); ++i) {
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                changed.wait(guard, [&] { return stopping || i < done + window; });
+                if (stopping) return;
+            }
+            std::ifstream inputFile(paths[i]);
+            std::stringstream buffer;
+            if (inputFile.is_open()) buffer << inputFile.rdbuf();
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                sources[i] = buffer.str();
+                state[i] = inputFile.is_open() ? LOADED : UNREADABLE;
+            }
+            changed.notify_all();
+        }
+    }
+};
+
+// =================== PUBLIC ===================
+
+std::string outputPathFor(const std::string& pattern, const std::string& input) {
+    size_t slash = input.find_last_of('/');
+    size_t dot = input.find_last_of('.');
+    std::string stem = (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+                     ? input.substr(0, dot) : input;
+    std::string path;
+    for (char c : pattern) {
+        if (c == '%') path += stem;
+        else path += c;
+    }
+    return path;
+}
+
+bool readInputList(const std::string& listPath, std::vector<std::string>& inputs) {
+    std::ifstream listFile;
+    if (listPath != "-") {
+        listFile.open(listPath);
+        if (!listFile.is_open()) return false;
+    }
+    std::istream& in = (listPath == "-") ? std::cin : listFile;
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos) continue;
+        size_t last = line.find_last_not_of(" \t\r");
+        inputs.push_back(line.substr(first, last - first + 1));
+    }
+    return true;
+}
+
+size_t runBatch(const std::vector<std::string>& inputs, const splc::Options& options,
+                unsigned workers, std::ostream& report, CompileCache* cache) {
+    struct Status {
+        bool ok = false;
+        std::string message; // What went wrong, or what was written
+        std::string diagnostics;
+    };
+    std::vector<Status> statuses(inputs.size());
+    if (workers == 0) workers = 1;
+    if (workers > inputs.size()) workers = static_cast<unsigned>(std::max<size_t>(inputs.size(), 1));
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        InputReader reader(inputs, READ_AHEAD_PER_WORKER * workers);
+        WorkStealingPool pool(inputs.size(), workers);
+        pool.run([&](size_t job) {
+            Status& status = statuses[job];
+            std::string source;
+            if (!reader.take(job, source)) {
+                reader.finished();
+                status.message = "could not read " + inputs[job];
+                return;
+            }
+            splc::Result result = compileCached(source, options, cache);
+            source.clear();
+            reader.finished();
+
+            status.diagnostics = result.diagnostics;
+            if (!result.ok) {
+                status.message = "rejected";
+                return;
+            }
+            status.ok = true;
+            for (const auto& output : result.outputs) {
+                std::string path = outputPathFor(output.artifact.path, inputs[job]);
+                OutputWriter out(path);
+                out.write(output.text);
+                if (!out.isOpen() || !out.close()) {
+                    status.ok = false;
+                    status.message = "could not write " + path;
+                    return;
+                }
+                status.message += (status.message.empty() ? "" : ", ") + path;
+            }
+        });
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t failed = 0;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        const Status& status = statuses[i];
+        if (!status.ok) ++failed;
+        report << (status.ok ? "OK     " : "FAILED ") << inputs[i] << ": " << status.message << std::endl;
+        if (!status.ok) report << status.diagnostics;
+    }
+    report << "Compiled " << inputs.size() - failed << " of " << inputs.size() << " files in "
+           << seconds << "s with " << workers << (workers == 1 ? " worker" : " workers") << std::endl;
+    return failed;
+}
@@ -0,0 +1,30 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "splc.h"
+#include "cache.h"
+
+/**
+ * @brief Batch mode of the command line: many inputs compiled concurrently.
+ * The inputs are dealt to the workers of a work-stealing pool, and a reader
+ * thread loads sources ahead of them, so reading the next files overlaps with
+ * compiling the current ones. Every artifact path is a template in which %
+ * stands for the input path without its extension, so each file gets its own
+ * outputs. A status line per file and a summary go to report at the end.
+ */
+
+// Replaces % in an artifact path by the input path without its extension
+std::string outputPathFor(const std::string& pattern, const std::string& input);
+
+// Reads one input path per line ("-" is stdin); returns false if it cannot be read
+bool readInputList(const std::string& listPath, std::vector<std::string>& inputs);
+
+// Compiles every input with workers threads, through cache unless it is
+// nullptr; returns the number of inputs that failed
+size_t runBatch(const std::vector<std::string>& inputs, const splc::Options& options,
+                unsigned workers, std::ostream& report, CompileCache* cache = nullptr);
+
+#endif // BATCH_H
@@ -0,0 +1,263 @@
+#include "cache.h"
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+// First line of every entry; entries of another format read as misses
+static const char* ENTRY_FORMAT = "splc-cache 1";
+
+// Stores between two scans of the directory for eviction
+static const unsigned TRIM_INTERVAL = 64;
+
+// Temporary files older than this were left by a process that died mid-write
+static const auto STALE_TEMPORARY = std::chrono::hours(1);
+
+// =================== Key hashing ===================
+
+/**
+ * Two independent 64-bit lanes over 8-byte words, mixed together at the end:
+ * fast rather than cryptographic, which is enough for keys nobody chooses
+ * adversarially. Every field is preceded by its length, so ("ab", "c") and
+ * ("a", "bc") hash differently.
+ */
+class KeyHasher {
+public:
+    void add(std::string_view field) {
+        mixWord(field.size());
+        size_t i = 0;
+        for (; i + 8 <= field.size(); i += 8) {
+            uint64_t word = 0;
+            for (size_t b = 0; b < 8; ++b) word |= static_cast<uint64_t>(static_cast<unsigned char>(field[i + b])) << (8 * b);
+            mixWord(word);
+        }
+        uint64_t tail = 0;
+        for (size_t b = 0; i + b < field.size(); ++b) tail |= static_cast<uint64_t>(static_cast<unsigned char>(field[i + b])) << (8 * b);
+        mixWord(tail);
+    }
+
+    std::string hex() const {
+        uint64_t high = finish(a ^ rotate(b, 17)), low = finish(b ^ rotate(a, 41));
+        static const char* digits = "0123456789abcdef";
+        std::string text(32, '0');
+        for (int i = 0; i < 16; ++i) {
+            text[15 - i] = digits[(high >> (4 * i)) & 0xf];
+            text[31 - i] = digits[(low >> (4 * i)) & 0xf];
+        }
+        return text;
+    }
+
+private:
+    uint64_t a = 0x243f6a8885a308d3ULL, b = 0x13198a2e03707344ULL;
+
+    static uint64_t rotate(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+    // splitmix64's finaliser
+    static uint64_t finish(uint64_t x) {
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    void mixWord(uint64_t word) {
+        a = rotate((a ^ word) * 0x9e3779b97f4a7c15ULL, 31);
+        b = rotate(b + word * 0xc2b2ae3d27d4eb4fULL, 27) * 0x165667b19e3779f9ULL;
+    }
+};
+
+// The running compiler: its version, and the size and time of its executable
+// so that every rebuild starts from an empty cache
+static std::string compilerIdentity() {
+    std::string identity = splc::VERSION;
+    std::error_code error;
+    fs::path exe = fs::read_symlink("/proc/self/exe", error);
+    if (!error) {
+        auto size = fs::file_size(exe, error);
+        auto time = fs::last_write_time(exe, error);
+        if (!error) {
+            identity += " " + std::to_string(size) + " "
+                      + std::to_string(time.time_since_epoch().count());
+            return identity;
+        }
+    }
+    return identity + " " __DATE__ " " __TIME__;
+}
+
+// =================== Entries ===================
+//   splc-cache 1
+//   ok
+//   length, newline and bytes of the diagnostics, of the log, then of each output
+
+static void putBlock(std::string& entry, const std::string& block) {
+    entry += std::to_string(block.size());
+    entry += '\n';
+    entry += block;
+}
+
+static bool getBlock(std::istream& in, std::string& block) {
+    size_t size;
+    if (!(in >> size) || in.get() != '\n') return false;
+    block.resize(size);
+    return static_cast<bool>(in.read(block.data(), static_cast<std::streamsize>(size)));
+}
+
+// =================== PUBLIC ===================
+
+CompileCache::CompileCache(std::string dir, uint64_t maxBytes)
+    : dir(std::move(dir)), maxBytes(maxBytes), identity(compilerIdentity()) {
+    std::error_code error;
+    fs::create_directories(this->dir, error);
+    usable = fs::is_directory(this->dir, error);
+}
+
+std::string CompileCache::defaultDirectory() {
+    const char* cacheHome = std::getenv("XDG_CACHE_HOME");
+    if (cacheHome && *cacheHome) return std::string(cacheHome) + "/splc";
+    const char* home = std::getenv("HOME");
+    if (home && *home) return std::string(home) + "/.cache/splc";
+    return "/tmp/splc-cache-" + std::to_string(::getuid());
+}
+
+std::string CompileCache::entryPath(const std::string& key) const {
+    return dir + "/" + key + ".entry";
+}
+
+std::string CompileCache::keyFor(std::string_view source, const splc::Options& options) const {
+    KeyHasher hasher;
+    hasher.add(identity);
+    for (const auto& artifact : splc::planOf(options)) {
+        hasher.add(artifact.kind);
+        hasher.add(std::to_string(static_cast<int>(artifact.stage)));
+    }
+    hasher.add(source);
+    return hasher.hex();
+}
+
+bool CompileCache::lookup(const std::string& key, const std::vector<splc::Artifact>& plan, splc::Result& result) {
+    if (!usable) return false;
+    std::string path = entryPath(key);
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) return false;
+
+    splc::Result entry;
+    std::string format;
+    int ok = -1;
+    bool valid = std::getline(in, format) && format == ENTRY_FORMAT && (in >> ok) && in.get() == '\n'
+              && getBlock(in, entry.diagnostics) && getBlock(in, entry.log);
+    for (size_t i = 0; i < plan.size() && valid; ++i) {
+        entry.outputs.push_back({plan[i], ""});
+        valid = getBlock(in, entry.outputs.back().text);
+    }
+    if (!valid || in.peek() != std::char_traits<char>::eof()) {
+        // Written by a process that died before it finished, or damaged since
+        in.close();
+        std::error_code error;
+        fs::remove(path, error);
+        return false;
+    }
+    entry.ok = ok == 1;
+
+    // Recently used: the last entry trim() would pick
+    std::error_code error;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), error);
+    result = std::move(entry);
+    return true;
+}
+
+void CompileCache::store(const std::string& key, const splc::Result& result) {
+    if (!usable) return;
+    std::string entry = ENTRY_FORMAT;
+    entry += result.ok ? "\n1\n" : "\n0\n";
+    putBlock(entry, result.diagnostics);
+    putBlock(entry, result.log);
+    for (const auto& output : result.outputs) putBlock(entry, output.text);
+
+    // Written under a name of its own, then renamed over the entry in one step
+    std::ostringstream temporary;
+    temporary << dir << "/.tmp-" << ::getpid() << "-" << std::this_thread::get_id() << "-" << key;
+    {
+        std::ofstream out(temporary.str(), std::ios::binary | std::ios::trunc);
+        out.write(entry.data(), static_cast<std::streamsize>(entry.size()));
+        out.close();
+        if (!out) {
+            std::error_code error;
+            fs::remove(temporary.str(), error);
+            return;
+        }
+    }
+    std::error_code error;
+    fs::rename(temporary.str(), entryPath(key), error);
+    if (error) fs::remove(temporary.str(), error);
+
+    if (stores++ % TRIM_INTERVAL == 0) trim();
+}
+
+void CompileCache::trim() {
+    std::unique_lock<std::mutex> guard(trimming, std::try_to_lock);
+    if (!guard.owns_lock() || !usable) return;
+
+    struct Entry {
+        fs::file_time_type used;
+        uintmax_t size;
+        fs::path path;
+    };
+    std::vector<Entry> entries;
+    uintmax_t total = 0;
+    auto now = fs::file_time_type::clock::now();
+    std::error_code error;
+    for (fs::directory_iterator it(dir, error), end; !error && it != end; it.increment(error)) {
+        std::error_code statError;
+        const fs::path& path = it->path();
+        auto used = fs::last_write_time(path, statError);
+        auto size = fs::file_size(path, statError);
+        if (statError) continue; // Removed by another process meanwhile
+        std::string name = path.filename().string();
+        if (name.rfind(".tmp-", 0) == 0) {
+            if (now - used > STALE_TEMPORARY) fs::remove(path, statError);
+        } else if (path.extension() == ".entry") {
+            entries.push_back({used, size, path});
+            total += size;
+        }
+    }
+    if (total <= maxBytes) return;
+
+    // Down to three quarters of the bound, so the next stores do not trim again at once
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry& x, const Entry& y) { return x.used < y.used; });
+    uintmax_t target = maxBytes / 4 * 3;
+    for (const auto& entry : entries) {
+        if (total <= target) break;
+        fs::remove(entry.path, error);
+        total -= entry.size;
+    }
+}
+
+splc::Result compileCached(std::string_view source, const splc::Options& options, CompileCache* cache) {
+    if (!cache || !cache->isUsable()) return splc::compile(source, options);
+    splc::TimeReport lookupTime;
+    std::string key;
+    splc::Result result;
+    bool hit;
+    {
+        splc::PhaseTimer timer(options.timeReport ? &lookupTime : nullptr, "cache lookup");
+        key = cache->keyFor(source, options);
+        hit = cache->lookup(key, splc::planOf(options), result);
+    }
+    if (hit) {
+        result.log += "Reused the cached result " + key + "\n";
+        result.timeReport = lookupTime;
+        return result;
+    }
+    result = splc::compile(source, options);
+    {
+        splc::PhaseTimer timer(options.timeReport ? &result.timeReport : nullptr, "cache store");
+        cache->store(key, result);
+    }
+    result.timeReport.phases.insert(result.timeReport.phases.begin(), lookupTime.phases.begin(), lookupTime.phases.end());
+    return result;
+}
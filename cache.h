@@ -0,0 +1,57 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include "splc.h"
+
+/**
+ * @brief Content-addressed on-disk cache of compile results. An entry is keyed
+ * by a 128-bit hash of the compiler's identity (splc::VERSION and the
+ * executable's size and modification time), the artifacts asked for (kind and
+ * stage; paths do not change the text) and the source bytes, and holds the
+ * whole splc::Result: diagnostics, log and outputs. A hit skips every phase.
+ *
+ * Entries are written to a temporary file and renamed into place, so several
+ * processes can share a directory: a reader sees an old entry, a new one or
+ * none. A hit refreshes the entry's modification time, and stores evict the
+ * least recently used entries once the directory grows past its bound.
+ */
+class CompileCache {
+public:
+    // dir is created if needed; maxBytes bounds the entries' total size
+    CompileCache(std::string dir, uint64_t maxBytes);
+
+    // $XDG_CACHE_HOME/splc, or ~/.cache/splc without it
+    static std::string defaultDirectory();
+
+    bool isUsable() const { return usable; }
+    const std::string& getDirectory() const { return dir; }
+
+    std::string keyFor(std::string_view source, const splc::Options& options) const;
+
+    // Fills result from the entry for key; false on a miss or an unreadable entry
+    bool lookup(const std::string& key, const std::vector<splc::Artifact>& plan, splc::Result& result);
+    void store(const std::string& key, const splc::Result& result);
+
+    // Deletes least recently used entries until the total is below the bound
+    void trim();
+
+private:
+    std::string dir;
+    uint64_t maxBytes;
+    bool usable = false;
+    std::string identity; // The compiler part of every key
+    std::atomic<unsigned> stores{0};
+    std::mutex trimming;
+
+    std::string entryPath(const std::string& key) const;
+};
+
+// splc::compile through the cache; cache may be nullptr
+splc::Result compileCached(std::string_view source, const splc::Options& options, CompileCache* cache);
+
+#endif // CACHE_H
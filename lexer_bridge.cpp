@@ -1,23 +1,68 @@
 #include "spl_lexer.h"
 #include "spl.tab.hpp"
+#include "ast.h"
 #include <memory>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
 
-static std::unique_ptr<Lexer> lexer_instance;
+// The lexer runs ahead of the parser: initialize_lexer reads every token, and
+// yylex hands them out. A lexical error is kept, message and all, and raised
+// when the parser asks for the token the lexer stopped at, so the parser sees
+// the same tokens and errors as if it drove the lexer itself.
+struct LexedToken {
+    int type;
+    std::string value;
+    int line;
+};
+
+static std::vector<LexedToken> lexed_tokens;
+static size_t next_token = 0;
+static std::string lexical_error;       // What the lexer threw, empty if it reached the end
+static std::string lexical_diagnostics; // What it printed before throwing
 int current_line_number = 1;
 
 int yylex() {
-    Token token = lexer_instance->getNextToken();
-    current_line_number = lexer_instance->line_number_;
+    if (next_token == lexed_tokens.size()) {
+        *frontEndDiagnostics << lexical_diagnostics;
+        throw std::runtime_error(lexical_error);
+    }
+    LexedToken& token = lexed_tokens[next_token++];
+    current_line_number = token.line;
 
     if (token.type == 0) {
         return 0;
     }
 
-    yylval.sval = new std::string(token.value);
+    yylval.sval = new std::string(std::move(token.value));
     return token.type;
 }
 
 void initialize_lexer(const std::string& source) {
-    lexer_instance = std::make_unique<Lexer>(source);
-}
\ No newline at end of file
+    lexed_tokens.clear();
+    next_token = 0;
+    lexical_error.clear();
+    lexical_diagnostics.clear();
+    current_line_number = 1;
+
+    Lexer lexer(source);
+    std::ostringstream diagnostics;
+    std::ostream* previous = frontEndDiagnostics;
+    frontEndDiagnostics = &diagnostics;
+    try {
+        while (true) {
+            Token token = lexer.getNextToken();
+            lexed_tokens.push_back({token.type, std::move(token.value), lexer.line_number_});
+            if (token.type == 0) break;
+        }
+    } catch (const std::runtime_error& e) {
+        lexical_error = e.what();
+        lexical_diagnostics = diagnostics.str();
+    }
+    frontEndDiagnostics = previous;
+}
+
+size_t lexed_token_count() {
+    return lexed_tokens.empty() || lexed_tokens.back().type != 0 ? lexed_tokens.size() : lexed_tokens.size() - 1;
+}
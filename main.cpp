@@ -1,16 +1,18 @@
 // main.cpp
 
+#include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <fstream>
 #include <sstream>
-#include "spl.tab.hpp"
-#include "ast.h" // Make sure to include your AST header
-#include "type_checker.h"
-#include "Intermediate-Code-Generation/codegen.h"
-
-extern void initialize_lexer(const std::string& source);
-extern int yyparse();
-extern AstNode* ast_root; // The global pointer from spl.y
+#include <vector>
+#include <thread>
+#include "splc.h"
+#include "batch.h"
+#include "server.h"
+#include "cache.h"
+#include "watch.h"
+#include "Intermediate-Code-Generation/writer.h"
 
 std::string readFileToString(const std::string& filePath) {
     std::ifstream inputFile(filePath);
@@ -22,64 +24,265 @@ std::string readFileToString(const std::string& filePath) {
     return buffer.str();
 }
 
-int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <source_file.txt>" << std::endl;
-        return 1;
-    }
+// ------------------- Output plan -------------------
+// What is written, when, and where: --emit KIND[@STAGE][=PATH] (see
+// splc::parseArtifact). The library renders only the artifacts asked for.
 
-    std::string source_code;
-    try {
-        source_code = readFileToString(argv[1]);
-        initialize_lexer(source_code);
-        
-        int parse_res = yyparse();
-        if(parse_res ==  0){
-            std::cout<<"Syntax accepted"<<std::endl;
-        }else{
-            return 1;
+static const char* savedMessage(const std::string& kind) {
+    if (kind == "basic") return "Executable BASIC code successfully generated in ";
+    if (kind == "html") return "HTML preview of generated code saved to ";
+    if (kind == "ir") return "Intermediate code saved to ";
+    return "AST saved to ";
+}
+
+static bool writeOutputs(const splc::Result& result, splc::TimeReport* report = nullptr) {
+    bool written = true;
+    for (const auto& output : result.outputs) {
+        const std::string& path = output.artifact.path;
+        splc::PhaseTimer timer(report, "write " + output.artifact.kind);
+        OutputWriter out(path);
+        if (!out.isOpen()) {
+            std::cerr << "Could not open " << path << std::endl;
+            written = false;
+            continue;
+        }
+        out.write(output.text);
+        if (!out.close()) {
+            std::cerr << "Could not write " << path << std::endl;
+            written = false;
+        } else if (path != "-") {
+            std::cout << savedMessage(output.artifact.kind) << path << std::endl;
         }
+    }
+    return written;
+}
 
-        if (ast_root) {
-            std::cout<<"Tokens accepted"<<std::endl;
-            //ast_root->print();
-
-            ast_root->checkNames();
-            std::cout<<"Variable Naming and Function Naming accepted"<<std::endl;
-            
-            TypeChecker typeChecker;
-            bool typeCheckPassed = typeChecker.typeCheck(static_cast<ProgramNode*>(ast_root));
-            
-            typeChecker.printErrors();
-            
-            if (typeCheckPassed) {
-                //typeChecker.printSymbolTable();
-                std::cout << "Types accepted" << std::endl;
-            } else {
-                std::cout << "Type error:" << std::endl;
-                return 1; // Exit with error code
-            }
+// Sends std::cout to std::cerr while it lives, so progress messages stay out
+// of artifacts written to stdout
+struct ProgressToStderr {
+    std::streambuf* previous = nullptr;
+    void enable() { previous = std::cout.rdbuf(std::cerr.rdbuf()); }
+    ~ProgressToStderr() { if (previous) std::cout.rdbuf(previous); }
+};
 
-            //Code Generation
-            CodeGen codeGen;
-            codeGen.setSymbolTable(&typeChecker.getSymbolTable());
+// Default bound of the compile cache
+static const uint64_t DEFAULT_CACHE_BYTES = 256ull << 20;
 
-            codeGen.generate(static_cast<ProgramNode*>(ast_root));
+// Reads a size such as 4096, 512K, 64M or 2G
+static bool parseSize(const std::string& text, uint64_t& bytes) {
+    char* end = nullptr;
+    unsigned long long value = std::strtoull(text.c_str(), &end, 10);
+    if (end == text.c_str()) return false;
+    std::string suffix = end;
+    if (suffix == "K" || suffix == "k") value <<= 10;
+    else if (suffix == "M" || suffix == "m") value <<= 20;
+    else if (suffix == "G" || suffix == "g") value <<= 30;
+    else if (!suffix.empty()) return false;
+    bytes = value;
+    return value > 0;
+}
 
-            codeGen.saveToHTML(); 
-            
-            codeGen.performInlining();
+// Writes the report of --time-report[=FORMAT][=PATH]: text or json, to stderr
+// unless a path is given
+static bool writeTimeReport(const splc::TimeReport& report, const std::string& format, const std::string& path) {
+    std::string text = format == "json" ? report.toJSON() + "\n" : report.toText();
+    if (path.empty()) {
+        std::cerr << text << std::flush;
+        return true;
+    }
+    OutputWriter out(path);
+    out.write(text);
+    if (out.isOpen() && out.close()) return true;
+    std::cerr << "Could not write " << path << std::endl;
+    return false;
+}
 
-            codeGen.startPostProcess();
-            
-            codeGen.saveCode(); 
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [--cache[=DIR]] [--cache-max=SIZE] [--emit KIND[@STAGE][=PATH]]... <source_file.txt>" << std::endl
+              << "       " << program << " [-j N] [--files-from LIST] [--emit ...]... <source_file.txt>..." << std::endl
+              << "       " << program << " --time-report[=text|json][=PATH] [--emit ...]... <source_file.txt>" << std::endl
+              << "       " << program << " --watch [--emit ...]... <source_file.txt>" << std::endl
+              << "       " << program << " --serve[=SOCKET]" << std::endl
+              << "       " << program << " --client[=SOCKET] [--emit ...]... <source_file.txt>" << std::endl
+              << "  KIND   ast (stages parsed, folded), ir or html (generated, inlined, optimized, final)," << std::endl
+              << "         basic (final)" << std::endl
+              << "  PATH   file to write, - for stdout; with several inputs % stands for the input" << std::endl
+              << "         without its extension" << std::endl
+              << "  LIST   file with one input per line, - for stdin" << std::endl
+              << "  SOCKET Unix socket of the compile server, " << defaultSocketPath() << " by default;" << std::endl
+              << "         the client compiles in-process when no server answers" << std::endl
+              << "  DIR    compile cache, " << CompileCache::defaultDirectory() << " by default; any mode can use it" << std::endl
+              << "  SIZE   bound of the cache in bytes, K, M or G (default 256M)" << std::endl
+              << "  Without --emit: --emit html --emit basic, or --emit basic=%.bas for several inputs" << std::endl;
+}
 
-            delete ast_root; 
+int main(int argc, char* argv[]) {
+    splc::Options options;
+    std::vector<std::string> inputs;
+    bool batch = false;
+    std::string serveOn, server; // Socket to serve on, socket of the server to use
+    std::string cacheDir;
+    bool watching = false;
+    std::string reportFormat, reportPath; // --time-report; no format means none
+    uint64_t cacheBytes = DEFAULT_CACHE_BYTES;
+    unsigned workers = std::thread::hardware_concurrency();
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string spec;
+        if (arg == "-j" && i + 1 < argc) arg += argv[++i];
+        if (arg.rfind("-j", 0) == 0 && arg.size() > 2) {
+            workers = static_cast<unsigned>(std::strtoul(arg.c_str() + 2, nullptr, 10));
+            if (workers == 0) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            batch = true;
+            continue;
+        }
+        if (arg == "--files-from" && i + 1 < argc) {
+            if (!readInputList(argv[++i], inputs)) {
+                std::cerr << "Could not read " << argv[i] << std::endl;
+                return 1;
+            }
+            batch = true;
+            continue;
+        }
+        if (arg == "--serve" || arg.rfind("--serve=", 0) == 0) {
+            serveOn = arg.size() > 8 ? arg.substr(8) : defaultSocketPath();
+            continue;
+        }
+        if (arg == "--client" || arg.rfind("--client=", 0) == 0) {
+            server = arg.size() > 9 ? arg.substr(9) : defaultSocketPath();
+            continue;
+        }
+        if (arg == "--time-report" || arg.rfind("--time-report=", 0) == 0) {
+            std::string spec = arg.size() > 14 ? arg.substr(14) : "text";
+            size_t equals = spec.find('=');
+            reportFormat = spec.substr(0, equals);
+            reportPath = equals == std::string::npos ? "" : spec.substr(equals + 1);
+            if ((reportFormat != "text" && reportFormat != "json") || (equals != std::string::npos && reportPath.empty())) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            options.timeReport = true;
+            continue;
+        }
+        if (arg == "--watch") {
+            watching = true;
+            continue;
+        }
+        if (arg == "--cache" || arg.rfind("--cache=", 0) == 0) {
+            cacheDir = arg.size() > 8 ? arg.substr(8) : CompileCache::defaultDirectory();
+            continue;
+        }
+        if (arg.rfind("--cache-max=", 0) == 0) {
+            if (!parseSize(arg.substr(12), cacheBytes)) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            continue;
+        }
+        if (arg == "--emit" && i + 1 < argc) spec = argv[++i];
+        else if (arg.rfind("--emit=", 0) == 0) spec = arg.substr(7);
+        else if (arg.rfind("-", 0) != 0) {
+            inputs.push_back(arg);
+            continue;
+        } else {
+            printUsage(argv[0]);
+            return 1;
         }
+        splc::Artifact artifact;
+        if (!splc::parseArtifact(spec, artifact)) {
+            std::cerr << "Invalid artifact: " << spec << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+        options.artifacts.push_back(artifact);
+    }
+    std::unique_ptr<CompileCache> cache;
+    if (!cacheDir.empty()) {
+        cache = std::make_unique<CompileCache>(cacheDir, cacheBytes);
+        if (!cache->isUsable()) std::cerr << "Could not use the cache in " << cacheDir << std::endl;
+    }
+
+    if (!serveOn.empty()) {
+        if (!inputs.empty() || batch || !server.empty() || !options.artifacts.empty()) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        return serve(serveOn, cache.get());
+    }
+    if (inputs.size() > 1) batch = true;
+    if (options.timeReport && (batch || watching || !serveOn.empty() || inputs.empty())) {
+        std::cerr << "--time-report takes a single input" << std::endl;
+        return 1;
+    }
+    if (watching && (batch || inputs.empty() || !server.empty())) {
+        std::cerr << "--watch takes a single input and compiles in-process" << std::endl;
+        return 1;
+    }
+    if (inputs.empty() && !batch) {
+        printUsage(argv[0]);
+        return 1;
+    }
 
+    // --- Batch: every input gets its own outputs ---
+    if (batch) {
+        if (!server.empty()) {
+            std::cerr << "--client takes a single input" << std::endl;
+            return 1;
+        }
+        if (options.artifacts.empty()) {
+            options.artifacts.push_back({"basic", splc::Stage::FINAL, "%.bas"});
+        }
+        for (const auto& artifact : options.artifacts) {
+            if (artifact.path.find('%') == std::string::npos) {
+                std::cerr << "With several inputs every --emit PATH needs a %: " << artifact.path << std::endl;
+                return 1;
+            }
+        }
+        return runBatch(inputs, options, workers, std::cout, cache.get()) == 0 ? 0 : 1;
+    }
+
+    if (options.artifacts.empty()) {
+        options.artifacts.push_back({"html", splc::Stage::GENERATED, "ICG.html"});
+        options.artifacts.push_back({"basic", splc::Stage::FINAL, "BASIC_EXECUTABLE.txt"});
+    }
+    ProgressToStderr progress;
+    for (const auto& artifact : options.artifacts) {
+        if (artifact.path == "-" && !progress.previous) progress.enable();
+    }
+
+    if (watching) {
+        return watch(inputs.front(), options, [](const splc::Result& result) {
+            std::cout << result.log << std::flush;
+            std::cerr << result.diagnostics << std::flush;
+            if (result.ok) writeOutputs(result);
+        });
+    }
+
+    splc::TimeReport report;
+    std::string source_code;
+    try {
+        splc::PhaseTimer timer(options.timeReport ? &report : nullptr, "read");
+        source_code = readFileToString(inputs.front());
     } catch (const std::runtime_error& e) {
         std::cerr << "Lexical error: " << e.what() << std::endl;
         return 1;
     }
-    return 0;
-}
\ No newline at end of file
+
+    // A report times this process, so it does not go through a server
+    splc::Result result;
+    if (server.empty() || options.timeReport || !compileRemote(server, source_code, options, result)) {
+        result = compileCached(source_code, options, cache.get());
+    }
+    std::cout << result.log << std::flush;
+    std::cerr << result.diagnostics << std::flush;
+    bool written = result.ok && writeOutputs(result, options.timeReport ? &result.timeReport : nullptr);
+    if (options.timeReport) {
+        report.phases.insert(report.phases.end(), result.timeReport.phases.begin(), result.timeReport.phases.end());
+        report.counters = result.timeReport.counters;
+        if (!writeTimeReport(report, reportFormat, reportPath)) return 1;
+    }
+    return written ? 0 : 1;
+}
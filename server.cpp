@@ -0,0 +1,228 @@
+#include "server.h"
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// First field of every request; a client and a server of different builds
+// refuse each other rather than misread the fields
+static const char* PROTOCOL = "splc1";
+
+// Largest field accepted, so a stray client cannot make the server allocate
+// without bound
+static const uint32_t MAX_FIELD = 1u << 30;
+
+// =================== Wire format ===================
+// A message is a sequence of fields, each a 32-bit big-endian length and that
+// many bytes. Numbers are sent as decimal text.
+//
+//   request:  "splc1" N (kind stage path)*N source
+//   response: ok diagnostics log text*N
+
+static void putField(std::string& message, std::string_view field) {
+    uint32_t length = htonl(static_cast<uint32_t>(field.size()));
+    message.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    message.append(field);
+}
+
+static bool writeAll(int fd, const std::string& message) {
+    size_t sent = 0;
+    while (sent < message.size()) {
+        ssize_t n = ::send(fd, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static bool readExactly(int fd, char* data, size_t size) {
+    size_t received = 0;
+    while (received < size) {
+        ssize_t n = ::read(fd, data + received, size - received);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        received += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static bool getField(int fd, std::string& field) {
+    uint32_t length;
+    if (!readExactly(fd, reinterpret_cast<char*>(&length), sizeof(length))) return false;
+    length = ntohl(length);
+    if (length > MAX_FIELD) return false;
+    field.resize(length);
+    return readExactly(fd, field.data(), length);
+}
+
+static bool getNumber(int fd, size_t& number) {
+    std::string field;
+    if (!getField(fd, field) || field.empty() || field.size() > 9) return false;
+    number = 0;
+    for (char c : field) {
+        if (c < '0' || c > '9') return false;
+        number = number * 10 + static_cast<size_t>(c - '0');
+    }
+    return true;
+}
+
+static bool fillAddress(const std::string& socketPath, sockaddr_un& address) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) return false;
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+    return true;
+}
+
+// =================== Server ===================
+
+void serveConnection(int fd, CompileCache* cache) {
+    std::string protocol;
+    while (getField(fd, protocol) && protocol == PROTOCOL) {
+        splc::Options options;
+        size_t count, stage;
+        if (!getNumber(fd, count)) break;
+        bool valid = true;
+        for (size_t i = 0; i < count && valid; ++i) {
+            splc::Artifact artifact;
+            valid = getField(fd, artifact.kind) && getNumber(fd, stage)
+                 && stage <= static_cast<size_t>(splc::Stage::FINAL)
+                 && getField(fd, artifact.path);
+            artifact.stage = static_cast<splc::Stage>(stage);
+            options.artifacts.push_back(artifact);
+        }
+        std::string source;
+        if (!valid || !getField(fd, source)) break;
+
+        splc::Result result = compileCached(source, options, cache);
+        std::string response;
+        putField(response, result.ok ? "1" : "0");
+        putField(response, result.diagnostics);
+        putField(response, result.log);
+        for (const auto& output : result.outputs) putField(response, output.text);
+        if (!writeAll(fd, response)) break;
+    }
+    ::close(fd);
+}
+
+static char servedPath[sizeof(sockaddr_un::sun_path)];
+
+static void stopServing(int) {
+    ::unlink(servedPath);
+    ::_exit(0);
+}
+
+// Hands every connection on listener to a thread of its own; returns only
+// when accepting fails
+static int acceptConnections(int listener, CompileCache* cache) {
+    while (true) {
+        int fd = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            std::cerr << "Could not accept: " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+        std::thread(serveConnection, fd, cache).detach();
+    }
+}
+
+std::string defaultSocketPath() {
+    const char* runtimeDir = std::getenv("XDG_RUNTIME_DIR");
+    if (runtimeDir && *runtimeDir) return std::string(runtimeDir) + "/splc.sock";
+    return "/tmp/splc-" + std::to_string(::getuid()) + ".sock";
+}
+
+int serve(const std::string& socketPath, CompileCache* cache) {
+    sockaddr_un address;
+    if (!fillAddress(socketPath, address)) {
+        std::cerr << "Socket path too long: " << socketPath << std::endl;
+        return 1;
+    }
+    int listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0) {
+        std::cerr << "Could not create a socket: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+
+    // A socket file nobody answers on is left over from a server that died
+    int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    bool taken = probe >= 0 && ::connect(probe, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+    if (probe >= 0) ::close(probe);
+    if (taken) {
+        std::cerr << "A server is already listening on " << socketPath << std::endl;
+        ::close(listener);
+        return 1;
+    }
+    ::unlink(socketPath.c_str());
+
+    // Only this user may connect: requests run with the server's rights
+    mode_t previousMask = ::umask(0077);
+    int bound = ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    ::umask(previousMask);
+    if (bound != 0 || ::listen(listener, SOMAXCONN) != 0) {
+        std::cerr << "Could not listen on " << socketPath << ": " << std::strerror(errno) << std::endl;
+        ::close(listener);
+        return 1;
+    }
+
+    std::memcpy(servedPath, address.sun_path, sizeof(servedPath));
+    std::signal(SIGINT, stopServing);
+    std::signal(SIGTERM, stopServing);
+    std::signal(SIGPIPE, SIG_IGN);
+    std::cout << "Serving on " << socketPath << std::endl;
+
+    int status = acceptConnections(listener, cache);
+    ::close(listener);
+    ::unlink(socketPath.c_str());
+    return status;
+}
+
+// =================== Client ===================
+
+bool compileOver(int fd, std::string_view source,
+                 const splc::Options& options, splc::Result& result) {
+    std::vector<splc::Artifact> plan = splc::planOf(options);
+    std::string request;
+    putField(request, PROTOCOL);
+    putField(request, std::to_string(plan.size()));
+    for (const auto& artifact : plan) {
+        putField(request, artifact.kind);
+        putField(request, std::to_string(static_cast<int>(artifact.stage)));
+        putField(request, artifact.path);
+    }
+    putField(request, source);
+
+    splc::Result answer;
+    std::string ok;
+    bool received = writeAll(fd, request) && getField(fd, ok)
+                 && getField(fd, answer.diagnostics) && getField(fd, answer.log);
+    for (size_t i = 0; i < plan.size() && received; ++i) {
+        answer.outputs.push_back({plan[i], ""});
+        received = getField(fd, answer.outputs.back().text);
+    }
+    if (!received) return false;
+    answer.ok = ok == "1";
+    result = std::move(answer);
+    return true;
+}
+
+bool compileRemote(const std::string& socketPath, std::string_view source,
+                   const splc::Options& options, splc::Result& result) {
+    sockaddr_un address;
+    if (!fillAddress(socketPath, address)) return false;
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+    bool answered = ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0
+                 && compileOver(fd, source, options, result);
+    ::close(fd);
+    return answered;
+}
@@ -0,0 +1,39 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <string>
+#include <string_view>
+#include "splc.h"
+#include "cache.h"
+
+/**
+ * @brief Compile server: a long-lived spl_compiler that keeps its static state
+ * (the front end's regexes, the allocator's pools) warm and compiles for
+ * clients over a Unix domain socket. A client sends its options and the source
+ * text it read itself; the server answers with the whole splc::Result, and the
+ * client writes the outputs where its own command line said. Each connection
+ * is served on a thread of its own and may carry any number of requests.
+ */
+
+// $XDG_RUNTIME_DIR/splc.sock, or /tmp/splc-UID.sock without it
+std::string defaultSocketPath();
+
+// Serves until SIGINT or SIGTERM, through cache unless it is nullptr;
+// returns the exit status
+int serve(const std::string& socketPath, CompileCache* cache = nullptr);
+
+// Answers the requests on one connected socket, through cache unless it is
+// nullptr, until the client hangs up or breaks the protocol; closes fd
+void serveConnection(int fd, CompileCache* cache = nullptr);
+
+// Sends one request over a socket served by serveConnection and reads the
+// answer; returns false, leaving result untouched, if none comes back
+bool compileOver(int fd, std::string_view source,
+                 const splc::Options& options, splc::Result& result);
+
+// Compiles through the server at socketPath; returns false, leaving result
+// untouched, if no server answers there
+bool compileRemote(const std::string& socketPath, std::string_view source,
+                   const splc::Options& options, splc::Result& result);
+
+#endif // SERVER_H
@@ -1772,5 +1772,5 @@ yyreturnlab:
 
 
 void yyerror(const char *s) {
-    std::cerr << "Syntax Error on line " << current_line_number << ": " << s << std::endl;
+    *frontEndDiagnostics << "Syntax Error on line " << current_line_number << ": " << s << std::endl;
 }
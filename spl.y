@@ -221,5 +221,5 @@ term:
 %%
 
 void yyerror(const char *s) {
-    std::cerr << "Syntax Error on line " << current_line_number << ": " << s << std::endl;
+    *frontEndDiagnostics << "Syntax Error on line " << current_line_number << ": " << s << std::endl;
 }
\ No newline at end of file
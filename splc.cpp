@@ -0,0 +1,792 @@
+#include "splc.h"
+#include <cctype>
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include "spl.tab.hpp"
+#include "ast.h"
+#include "type_checker.h"
+#include "Intermediate-Code-Generation/ast_copy.h"
+#include "Intermediate-Code-Generation/codegen.h"
+#include "Intermediate-Code-Generation/const_fold.h"
+#include "Intermediate-Code-Generation/evaluator.h"
+#include "Intermediate-Code-Generation/optimizer.h"
+#include "Intermediate-Code-Generation/writer.h"
+
+extern void initialize_lexer(const std::string& source);
+extern size_t lexed_token_count();
+extern int yyparse();
+extern AstNode* ast_root; // The global pointer from spl.y
+
+namespace splc {
+
+// The lexer, the parser and the name checks keep their state in globals
+// (ast_root, the lexer instance, frontEndDiagnostics), and AST dumps go through
+// std::cout: those steps run under this lock. Everything after them works on
+// objects of its own, so compiles overlap from type checking on.
+static std::mutex frontEndLock;
+
+// =================== Time report ===================
+
+static double cpuNowMs() {
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+}
+
+static double wallNowMs() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+PhaseTimer::PhaseTimer(TimeReport* report, std::string phase)
+    : report(report), phase(std::move(phase)), wallStart(0), cpuStart(0) {
+    if (!report) return;
+    wallStart = wallNowMs();
+    cpuStart = cpuNowMs();
+}
+
+PhaseTimer::~PhaseTimer() {
+    if (!report) return;
+    report->phases.push_back({phase, wallNowMs() - wallStart, cpuNowMs() - cpuStart});
+}
+
+std::string TimeReport::toText() const {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+    out << std::left << std::setw(24) << "Phase" << std::right << std::setw(12) << "Wall ms" << std::setw(12) << "CPU ms" << "\n";
+    double wall = 0, cpu = 0;
+    for (const auto& phase : phases) {
+        out << std::left << std::setw(24) << phase.phase << std::right
+            << std::setw(12) << phase.wallMs << std::setw(12) << phase.cpuMs << "\n";
+        wall += phase.wallMs;
+        cpu += phase.cpuMs;
+    }
+    out << std::left << std::setw(24) << "total" << std::right << std::setw(12) << wall << std::setw(12) << cpu << "\n";
+    if (!counters.empty()) {
+        out << "\n" << std::left << std::setw(24) << "Counter" << std::right << std::setw(12) << "Value" << "\n";
+        for (const auto& [name, value] : counters) {
+            out << std::left << std::setw(24) << name << std::right << std::setw(12) << value << "\n";
+        }
+    }
+    return out.str();
+}
+
+// Phase names are ours and paths never reach them, but quote them properly anyway
+static std::string jsonString(const std::string& text) {
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') quoted += '\\';
+        if (static_cast<unsigned char>(c) < 0x20) {
+            char escape[8];
+            std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+            quoted += escape;
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+std::string TimeReport::toJSON() const {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+    out << "{\"phases\":[";
+    double wall = 0, cpu = 0;
+    for (size_t i = 0; i < phases.size(); ++i) {
+        out << (i ? "," : "") << "{\"phase\":" << jsonString(phases[i].phase)
+            << ",\"wall_ms\":" << phases[i].wallMs << ",\"cpu_ms\":" << phases[i].cpuMs << "}";
+        wall += phases[i].wallMs;
+        cpu += phases[i].cpuMs;
+    }
+    out << "],\"total\":{\"wall_ms\":" << wall << ",\"cpu_ms\":" << cpu << "},\"counters\":{";
+    for (size_t i = 0; i < counters.size(); ++i) {
+        out << (i ? "," : "") << jsonString(counters[i].first) << ":" << counters[i].second;
+    }
+    out << "}}";
+    return out.str();
+}
+
+// "1 step", "2 steps"
+static std::string plural(long long count, const std::string& noun) {
+    return std::to_string(count) + " " + noun + (count == 1 ? "" : "s");
+}
+
+// Nodes of the tree under node, lists not counted
+static size_t countNodes(const AstNode* node);
+
+template <typename T>
+static size_t countNodes(const AstNodeList<T>* list) {
+    size_t count = 0;
+    if (list) {
+        for (const auto* element : list->elements) count += countNodes(element);
+    }
+    return count;
+}
+
+static size_t countNodes(const AstNode* node) {
+    if (!node) return 0;
+    if (auto* n = dynamic_cast<const UnaryOpNode*>(node)) return 1 + countNodes(n->operand);
+    if (auto* n = dynamic_cast<const BinaryOpNode*>(node)) return 1 + countNodes(n->left) + countNodes(n->right);
+    if (auto* n = dynamic_cast<const FuncCallNode*>(node)) return 1 + countNodes(n->args);
+    if (auto* n = dynamic_cast<const ProcCallNode*>(node)) return 1 + countNodes(n->args);
+    if (auto* n = dynamic_cast<const PrintNode*>(node)) return 1 + countNodes(n->expression);
+    if (auto* n = dynamic_cast<const ReturnNode*>(node)) return 1 + countNodes(n->expression);
+    if (auto* n = dynamic_cast<const AssignNode*>(node)) return 1 + countNodes(n->var) + countNodes(n->expression);
+    if (auto* n = dynamic_cast<const IfNode*>(node)) return 1 + countNodes(n->condition) + countNodes(n->then_branch);
+    if (auto* n = dynamic_cast<const IfElseNode*>(node)) {
+        return 1 + countNodes(n->condition) + countNodes(n->then_branch) + countNodes(n->else_branch);
+    }
+    if (auto* n = dynamic_cast<const WhileNode*>(node)) return 1 + countNodes(n->condition) + countNodes(n->body);
+    if (auto* n = dynamic_cast<const DoUntilNode*>(node)) return 1 + countNodes(n->body) + countNodes(n->condition);
+    if (auto* n = dynamic_cast<const BodyNode*>(node)) return 1 + countNodes(n->locals) + countNodes(n->statements);
+    if (auto* n = dynamic_cast<const ProcDefNode*>(node)) return 1 + countNodes(n->params) + countNodes(n->body);
+    if (auto* n = dynamic_cast<const FuncDefNode*>(node)) return 1 + countNodes(n->params) + countNodes(n->body);
+    if (auto* n = dynamic_cast<const MainProgNode*>(node)) return 1 + countNodes(n->locals) + countNodes(n->statements);
+    if (auto* n = dynamic_cast<const ProgramNode*>(node)) {
+        return 1 + countNodes(n->globals) + countNodes(n->procs) + countNodes(n->funcs) + countNodes(n->main);
+    }
+    return 1; // Var, Number, String, Bool, Halt
+}
+
+// =================== Artifacts ===================
+
+static const char* stageName(Stage stage) {
+    switch (stage) {
+        case Stage::PARSED: return "parsed";
+        case Stage::FOLDED: return "folded";
+        case Stage::GENERATED: return "generated";
+        case Stage::INLINED: return "inlined";
+        case Stage::OPTIMIZED: return "optimized";
+        default: return "final";
+    }
+}
+
+static bool parseStage(const std::string& name, Stage& stage) {
+    if (name == "parsed") stage = Stage::PARSED;
+    else if (name == "folded") stage = Stage::FOLDED;
+    else if (name == "generated") stage = Stage::GENERATED;
+    else if (name == "inlined") stage = Stage::INLINED;
+    else if (name == "optimized") stage = Stage::OPTIMIZED;
+    else if (name == "final") stage = Stage::FINAL;
+    else return false;
+    return true;
+}
+
+bool parseArtifact(const std::string& spec, Artifact& artifact) {
+    size_t equals = spec.find('=');
+    std::string head = spec.substr(0, equals);
+    size_t at = head.find('@');
+    artifact.kind = head.substr(0, at);
+
+    // Defaults: the AST as parsed and the code before inlining go to stdout;
+    // the HTML preview and the BASIC program to the files they always had
+    Stage first, last;
+    if (artifact.kind == "ast") {
+        artifact.stage = Stage::PARSED; artifact.path = "-";
+        first = Stage::PARSED; last = Stage::FOLDED;
+    } else if (artifact.kind == "ir") {
+        artifact.stage = Stage::GENERATED; artifact.path = "-";
+        first = Stage::GENERATED; last = Stage::FINAL;
+    } else if (artifact.kind == "html") {
+        artifact.stage = Stage::GENERATED; artifact.path = "ICG.html";
+        first = Stage::GENERATED; last = Stage::FINAL;
+    } else if (artifact.kind == "basic") {
+        artifact.stage = Stage::FINAL; artifact.path = "BASIC_EXECUTABLE.txt";
+        first = Stage::FINAL; last = Stage::FINAL;
+    } else {
+        return false;
+    }
+
+    if (at != std::string::npos && !parseStage(head.substr(at + 1), artifact.stage)) return false;
+    if (artifact.stage < first || artifact.stage > last) return false;
+    if (equals != std::string::npos) artifact.path = spec.substr(equals + 1);
+    return !artifact.path.empty();
+}
+
+std::vector<Artifact> planOf(const Options& options) {
+    std::vector<Artifact> plan = options.artifacts;
+    if (plan.empty()) plan.push_back({"basic", Stage::FINAL, "BASIC_EXECUTABLE.txt"});
+    return plan;
+}
+
+const Output* Result::find(const std::string& kind) const {
+    for (const auto& output : outputs) {
+        if (output.artifact.kind == kind) return &output;
+    }
+    return nullptr;
+}
+
+// Renders the outputs taken at this stage
+static void take(Result& result, Stage stage, AstNode* ast, const CodeGen& codeGen, TimeReport* report) {
+    for (auto& output : result.outputs) {
+        if (output.artifact.stage != stage) continue;
+        PhaseTimer timer(report, "render " + output.artifact.kind + "@" + stageName(stage));
+        if (output.artifact.kind == "ast") {
+            // AstNode::print writes to std::cout
+            std::ostringstream dump;
+            std::lock_guard<std::mutex> guard(frontEndLock);
+            std::streambuf* previous = std::cout.rdbuf(dump.rdbuf());
+            ast->print();
+            std::cout.rdbuf(previous);
+            output.text = dump.str();
+            continue;
+        }
+        OutputWriter out;
+        if (output.artifact.kind == "html") codeGen.writeHTML(out);
+        else codeGen.writeCode(out);
+        output.text = out.release();
+    }
+}
+
+// Points the front end's diagnostics at a buffer for the length of a compile
+struct DiagnosticsTo {
+    std::ostream* previous;
+    explicit DiagnosticsTo(std::ostream& out) : previous(frontEndDiagnostics) { frontEndDiagnostics = &out; }
+    ~DiagnosticsTo() { frontEndDiagnostics = previous; }
+};
+
+// =================== Compile ===================
+
+// Lexes and parses source; nullptr if it is rejected. Runs under the front-end lock.
+static std::unique_ptr<AstNode> parseSource(std::string_view source, std::ostream& diagnostics,
+                                            TimeReport* report = nullptr) {
+    DiagnosticsTo redirect(diagnostics);
+    ast_root = nullptr;
+    int parse_res;
+    try {
+        {
+            PhaseTimer timer(report, "lex");
+            initialize_lexer(std::string(source));
+        }
+        if (report) report->addCounter("tokens", lexed_token_count());
+        PhaseTimer timer(report, "parse");
+        parse_res = yyparse();
+    } catch (const std::runtime_error& e) {
+        diagnostics << "Lexical error: " << e.what() << std::endl;
+        return nullptr;
+    }
+    std::unique_ptr<AstNode> ast(ast_root);
+    ast_root = nullptr;
+    if (parse_res != 0) return nullptr;
+    return ast;
+}
+
+// The AST dump of node. Runs under the front-end lock.
+static std::string dumpOf(const AstNode* node) {
+    std::ostringstream text;
+    std::streambuf* previous = std::cout.rdbuf(text.rdbuf());
+    node->print();
+    std::cout.rdbuf(previous);
+    return text.str();
+}
+
+// Lexes, parses and checks names under the front-end lock; nullptr if the
+// source is rejected. With dumps, fills in the AST dump of every definition.
+static std::unique_ptr<AstNode> parseChecked(std::string_view source, std::ostream& diagnostics,
+                                             std::ostream& log, std::map<std::string, std::string>* dumps,
+                                             TimeReport* report = nullptr) {
+    std::lock_guard<std::mutex> guard(frontEndLock);
+    std::unique_ptr<AstNode> ast = parseSource(source, diagnostics, report);
+    if (!ast) return nullptr;
+    log << "Syntax accepted" << std::endl;
+    log << "Tokens accepted" << std::endl;
+    if (report) report->addCounter("ast_nodes", countNodes(ast.get()));
+
+    DiagnosticsTo redirect(diagnostics);
+    {
+        PhaseTimer timer(report, "checkNames");
+        ast->checkNames();
+    }
+    log << "Variable Naming and Function Naming accepted" << std::endl;
+
+    if (dumps) {
+        ProgramNode* program = static_cast<ProgramNode*>(ast.get());
+        (*dumps)["glob"] = dumpOf(program->globals);
+        for (const auto* proc : program->procs->elements) (*dumps)["proc " + proc->name] = dumpOf(proc);
+        for (const auto* func : program->funcs->elements) (*dumps)["func " + func->name] = dumpOf(func);
+        (*dumps)["main"] = dumpOf(program->main);
+    }
+    return ast;
+}
+
+static bool typeChecked(ProgramNode* program, TypeChecker& typeChecker, std::ostream& diagnostics,
+                        std::ostream& log, TimeReport* report = nullptr) {
+    bool typeCheckPassed;
+    {
+        PhaseTimer timer(report, "typeCheck");
+        typeCheckPassed = typeChecker.typeCheck(program);
+    }
+    if (report) report->addCounter("symbols", typeChecker.getSymbolTable().getDeclaredCount());
+    for (const auto& error : typeChecker.getErrorMessages()) {
+        diagnostics << "Type error: " << error << std::endl;
+    }
+    if (!typeCheckPassed) {
+        log << "Type error:" << std::endl;
+        return false;
+    }
+    log << "Types accepted" << std::endl;
+    return true;
+}
+
+// The last stage an output of result is taken at
+static Stage lastStageOf(const Result& result) {
+    Stage lastStage = Stage::PARSED;
+    for (const auto& output : result.outputs) {
+        if (output.artifact.stage > lastStage) lastStage = output.artifact.stage;
+    }
+    return lastStage;
+}
+
+// Runs the phases from code generation on, on a folded program, up to the
+// last stage an output is taken at
+static void generateCode(Result& result, ProgramNode* program, CodeGen& codeGen,
+                         std::ostream& log, TimeReport* report = nullptr) {
+    Stage lastStage = lastStageOf(result);
+
+    //Compile-time Evaluation and Code Generation
+    if (lastStage >= Stage::GENERATED) {
+        Evaluator evaluator;
+        bool evaluated;
+        {
+            PhaseTimer timer(report, "evaluate");
+            evaluated = evaluator.evaluate(program);
+        }
+        if (evaluated) {
+            log << "Compile-time evaluation ran the whole program in "
+                << plural(evaluator.getStepCount(), "step") << std::endl;
+        } else {
+            log << "Compile-time evaluation ran "
+                << plural(static_cast<long long>(evaluator.getEvaluatedCount()), "statement") << " of main" << std::endl;
+        }
+        {
+            PhaseTimer timer(report, "generate");
+            codeGen.generate(program, &evaluator);
+        }
+        if (report) report->addCounter("instructions_generated", codeGen.code.size());
+        take(result, Stage::GENERATED, program, codeGen, report);
+    }
+
+    if (lastStage >= Stage::INLINED) {
+        {
+            PhaseTimer timer(report, "performInlining");
+            codeGen.performInlining();
+        }
+        if (report) {
+            report->addCounter("inlining_passes", codeGen.getInliningPassCount());
+            report->addCounter("instructions_inlined", codeGen.code.size());
+        }
+        take(result, Stage::INLINED, program, codeGen, report);
+    }
+
+    //Optimisation
+    if (lastStage >= Stage::OPTIMIZED) {
+        Optimizer optimizer;
+        {
+            PhaseTimer timer(report, "optimize");
+            optimizer.optimize(codeGen.code);
+        }
+        optimizer.printReport(log);
+        if (report) report->addCounter("instructions_optimized", codeGen.code.size());
+        take(result, Stage::OPTIMIZED, program, codeGen, report);
+    }
+
+    if (lastStage >= Stage::FINAL) {
+        {
+            PhaseTimer timer(report, "startPostProcess");
+            codeGen.startPostProcess();
+        }
+        if (report) {
+            report->addCounter("labels", codeGen.getLabelCount());
+            report->addCounter("instructions_final", codeGen.code.size());
+        }
+        take(result, Stage::FINAL, program, codeGen, report);
+    }
+}
+
+// Runs the phases after type checking up to the last stage an output is taken at
+static void generateOutputs(Result& result, ProgramNode* program, const TypeChecker& typeChecker,
+                            std::ostream& log, TimeReport* report = nullptr) {
+    CodeGen codeGen;
+    codeGen.setSymbolTable(&typeChecker.getSymbolTable());
+    take(result, Stage::PARSED, program, codeGen, report);
+
+    //Constant Folding
+    if (lastStageOf(result) >= Stage::FOLDED) {
+        {
+            PhaseTimer timer(report, "fold");
+            ConstantFolder folder;
+            folder.fold(program);
+        }
+        take(result, Stage::FOLDED, program, codeGen, report);
+    }
+
+    generateCode(result, program, codeGen, log, report);
+}
+
+Result compile(std::string_view source, const Options& options) {
+    Result result;
+    for (const auto& artifact : planOf(options)) result.outputs.push_back({artifact, ""});
+    TimeReport* report = options.timeReport ? &result.timeReport : nullptr;
+
+    std::ostringstream diagnostics, log;
+    std::unique_ptr<AstNode> ast = parseChecked(source, diagnostics, log, nullptr, report);
+    if (ast) {
+        ProgramNode* program = static_cast<ProgramNode*>(ast.get());
+        TypeChecker typeChecker;
+        result.ok = typeChecked(program, typeChecker, diagnostics, log, report);
+        if (result.ok) generateOutputs(result, program, typeChecker, log, report);
+    }
+    result.diagnostics = diagnostics.str();
+    result.log = log.str();
+    return result;
+}
+
+// =================== Session ===================
+
+/**
+ * One definition of a version of the source: its kind (glob, proc, func or
+ * main) and text as the splitter found them, the AST parsed from that text
+ * alone, and what the name checks said about it. Sessions keep these by text,
+ * so an unchanged definition is never parsed or name checked again, nor
+ * folded again once code has been generated from it.
+ */
+struct Session::Definition {
+    std::string name; // "glob", "main", "proc NAME" or "func NAME"
+    std::string text;
+    std::unique_ptr<AstNode> node;
+    std::string dump;
+    std::string nameDiagnostics;
+    std::unique_ptr<AstNode> folded; // Copy of node the constant folder rewrote
+};
+
+struct Chunk {
+    const char* kind;
+    std::string_view text;
+};
+
+/**
+ * Cuts source into its definitions without parsing it: the inside of glob
+ * and main, and every proc and func with its braces. Returns false if the
+ * source is not laid out like a program, which the parser then reports.
+ */
+static bool splitDefinitions(std::string_view source, std::vector<Chunk>& chunks) {
+    size_t pos = 0;
+    auto skipSpace = [&] {
+        while (pos < source.size() && std::isspace(static_cast<unsigned char>(source[pos]))) ++pos;
+    };
+    auto keyword = [&](std::string_view word) {
+        skipSpace();
+        if (source.compare(pos, word.size(), word) != 0) return false;
+        pos += word.size();
+        return pos >= source.size() || !std::isalnum(static_cast<unsigned char>(source[pos]));
+    };
+    auto open = [&] {
+        skipSpace();
+        return pos < source.size() && source[pos++] == '{';
+    };
+    // From just after an opening brace to just after the brace closing it
+    auto closeBrace = [&] {
+        for (int depth = 1; pos < source.size(); ++pos) {
+            char c = source[pos];
+            if (c == '"') {
+                pos = source.find('"', pos + 1);
+                if (pos == std::string_view::npos) return false;
+            } else if (c == '{') {
+                ++depth;
+            } else if (c == '}' && --depth == 0) {
+                ++pos;
+                return true;
+            }
+        }
+        return false;
+    };
+    auto block = [&](const char* kind) {
+        size_t begin = pos;
+        if (!closeBrace()) return false;
+        chunks.push_back({kind, source.substr(begin, pos - 1 - begin)});
+        return true;
+    };
+    auto definitions = [&](const char* kind) {
+        while (true) {
+            skipSpace();
+            if (pos >= source.size()) return false;
+            if (source[pos] == '}') {
+                ++pos;
+                return true;
+            }
+            size_t begin = pos;
+            pos = source.find_first_of("{}", pos);
+            if (pos == std::string_view::npos || source[pos] == '}') return false;
+            ++pos;
+            if (!closeBrace()) return false;
+            chunks.push_back({kind, source.substr(begin, pos - begin)});
+        }
+    };
+
+    if (!keyword("glob") || !open() || !block("glob")) return false;
+    if (!keyword("proc") || !open() || !definitions("proc")) return false;
+    if (!keyword("func") || !open() || !definitions("func")) return false;
+    if (!keyword("main") || !open() || !block("main")) return false;
+    skipSpace();
+    return pos == source.size();
+}
+
+// Parses one definition inside an otherwise empty program; nullptr if it does
+// not parse on its own. Runs under the front-end lock.
+static std::unique_ptr<AstNode> parseDefinition(const Chunk& chunk, std::string& name) {
+    std::string kind = chunk.kind;
+    std::string text(chunk.text);
+    std::string wrapped = kind == "glob" ? "glob {" + text + "} proc { } func { } main { var { } halt }"
+                        : kind == "proc" ? "glob { } proc {" + text + "} func { } main { var { } halt }"
+                        : kind == "func" ? "glob { } proc { } func {" + text + "} main { var { } halt }"
+                        : "glob { } proc { } func { } main {" + text + "}";
+    std::ostringstream ignored;
+    std::unique_ptr<AstNode> ast = parseSource(wrapped, ignored);
+    ProgramNode* program = static_cast<ProgramNode*>(ast.get());
+    if (!program) return nullptr;
+
+    std::unique_ptr<AstNode> node;
+    if (kind == "glob") {
+        node.reset(program->globals);
+        program->globals = nullptr;
+        name = "glob";
+    } else if (kind == "main") {
+        node.reset(program->main);
+        program->main = nullptr;
+        name = "main";
+    } else if (kind == "proc" && program->procs->elements.size() == 1) {
+        name = "proc " + program->procs->elements[0]->name;
+        node.reset(program->procs->elements[0]);
+        program->procs->elements.clear();
+    } else if (kind == "func" && program->funcs->elements.size() == 1) {
+        name = "func " + program->funcs->elements[0]->name;
+        node.reset(program->funcs->elements[0]);
+        program->funcs->elements.clear();
+    }
+    return node;
+}
+
+// A program put together from the definitions a session holds, which it
+// borrows: they go back untouched when it is destroyed
+struct BorrowedProgram {
+    ProgramNode program{nullptr, new AstNodeList<ProcDefNode>(), new AstNodeList<FuncDefNode>(), nullptr};
+    void add(AstNode* definition) {
+        if (auto* main = dynamic_cast<MainProgNode*>(definition)) program.main = main;
+        else if (auto* proc = dynamic_cast<ProcDefNode*>(definition)) program.procs->elements.push_back(proc);
+        else if (auto* func = dynamic_cast<FuncDefNode*>(definition)) program.funcs->elements.push_back(func);
+        else program.globals = static_cast<AstNodeList<VarNode>*>(definition);
+    }
+    ~BorrowedProgram() {
+        program.globals = nullptr;
+        program.main = nullptr;
+        program.procs->elements.clear();
+        program.funcs->elements.clear();
+    }
+};
+
+// Definitions called in a dump: its ProcCall(name) and FuncCall(name) lines
+static std::vector<std::string> calleesIn(const std::string& dump) {
+    std::vector<std::string> callees;
+    std::istringstream lines(dump);
+    std::string line;
+    while (std::getline(lines, line)) {
+        size_t first = line.find_first_not_of(' ');
+        if (first == std::string::npos || line.back() != ')') continue;
+        if (line.compare(first, 9, "ProcCall(") == 0) {
+            callees.push_back("proc " + line.substr(first + 9, line.size() - first - 10));
+        } else if (line.compare(first, 9, "FuncCall(") == 0) {
+            callees.push_back("func " + line.substr(first + 9, line.size() - first - 10));
+        }
+    }
+    return callees;
+}
+
+// A copy of a definition, folded as ConstantFolder::fold folds it in a program
+static std::unique_ptr<AstNode> foldedCopy(const AstNode* definition) {
+    std::unique_ptr<AstNode> copy(copyDefinition(definition));
+    ConstantFolder folder;
+    if (auto* main = dynamic_cast<MainProgNode*>(copy.get())) {
+        folder.foldStatements(main->statements);
+    } else if (auto* proc = dynamic_cast<ProcDefNode*>(copy.get())) {
+        if (proc->body) folder.foldStatements(proc->body->statements);
+    } else if (auto* func = dynamic_cast<FuncDefNode*>(copy.get())) {
+        if (func->body) folder.foldStatements(func->body->statements);
+    }
+    return copy;
+}
+
+// The body specialised copies are made from, nullptr for glob and main
+static const BodyNode* bodyOf(const AstNode* definition) {
+    if (auto* proc = dynamic_cast<const ProcDefNode*>(definition)) return proc->body;
+    if (auto* func = dynamic_cast<const FuncDefNode*>(definition)) return func->body;
+    return nullptr;
+}
+
+Session::Session(Options options) : options(std::move(options)), specializer(std::make_unique<Specializer>()) {}
+Session::~Session() = default;
+
+bool Session::reparse(std::string_view source, std::vector<Definition*>& used) {
+    std::vector<Chunk> chunks;
+    if (!splitDefinitions(source, chunks)) return false;
+
+    std::lock_guard<std::mutex> guard(frontEndLock);
+    std::map<std::string, std::unique_ptr<Definition>> kept;
+    for (const auto& chunk : chunks) {
+        std::string key = std::string(chunk.kind) + '\n' + std::string(chunk.text);
+        auto again = kept.find(key); // The same text twice in this version
+        if (again != kept.end()) {
+            used.push_back(again->second.get());
+            continue;
+        }
+        auto known = parsed.find(key);
+        if (known != parsed.end()) {
+            used.push_back(known->second.get());
+            kept[key] = std::move(known->second);
+            parsed.erase(known);
+            continue;
+        }
+
+        auto definition = std::make_unique<Definition>();
+        definition->text = chunk.text;
+        definition->node = parseDefinition(chunk, definition->name);
+        if (!definition->node) {
+            for (auto& [key, moved] : kept) parsed[key] = std::move(moved);
+            return false;
+        }
+        std::ostringstream nameDiagnostics;
+        {
+            DiagnosticsTo redirect(nameDiagnostics);
+            definition->node->checkNames();
+        }
+        definition->nameDiagnostics = nameDiagnostics.str();
+        definition->dump = dumpOf(definition->node.get());
+        used.push_back(definition.get());
+        kept[key] = std::move(definition);
+    }
+    // Definitions this version no longer has are dropped, with their copies
+    for (const auto& [key, dropped] : parsed) {
+        if (dropped->folded) specializer->forget(bodyOf(dropped->folded.get()));
+    }
+    parsed = std::move(kept);
+    return true;
+}
+
+const Result& Session::update(std::string_view source) {
+    result = Result();
+    for (const auto& artifact : planOf(options)) result.outputs.push_back({artifact, ""});
+    reused = false;
+    generatedFromCount = foldedCount = 0;
+
+    // The front end: definition by definition when the source splits into
+    // definitions that parse on their own, otherwise (syntax errors, whose
+    // line numbers need the whole source) in one piece
+    std::ostringstream diagnostics, log;
+    std::map<std::string, std::string> dumps;
+    std::unique_ptr<AstNode> ast;
+    BorrowedProgram borrowed;
+    ProgramNode* program = nullptr;
+    std::vector<Definition*> used;
+    if (reparse(source, used)) {
+        log << "Syntax accepted" << std::endl;
+        log << "Tokens accepted" << std::endl;
+        log << "Variable Naming and Function Naming accepted" << std::endl;
+        for (Definition* definition : used) {
+            diagnostics << definition->nameDiagnostics;
+            dumps[definition->name] = definition->dump;
+            borrowed.add(definition->node.get());
+        }
+        program = &borrowed.program;
+    } else {
+        ast = parseChecked(source, diagnostics, log, &dumps);
+        program = static_cast<ProgramNode*>(ast.get());
+    }
+
+    if (program) {
+        changed.clear();
+        for (const auto& [name, dump] : dumps) {
+            auto previous = definitions.find(name);
+            if (previous == definitions.end() || previous->second != dump) changed.push_back(name);
+        }
+        for (const auto& [name, dump] : definitions) {
+            if (!dumps.count(name)) changed.push_back(name); // Deleted
+        }
+        definitions = std::move(dumps);
+
+        TypeChecker typeChecker;
+        result.ok = typeChecked(program, typeChecker, diagnostics, log);
+        if (result.ok) {
+            // The code is generated from main and what it calls, directly or
+            // not; an AST artifact shows every definition
+            bool wholeProgram = false;
+            for (const auto& output : result.outputs) wholeProgram |= output.artifact.kind == "ast";
+            std::set<std::string> reached;
+            std::vector<std::string> pending = {"glob", "main"};
+            if (wholeProgram) {
+                for (const auto& [name, dump] : definitions) pending.push_back(name);
+            }
+            while (!pending.empty()) {
+                std::string name = pending.back();
+                pending.pop_back();
+                if (!reached.insert(name).second || !definitions.count(name)) continue;
+                for (auto& callee : calleesIn(definitions[name])) pending.push_back(std::move(callee));
+            }
+            // In source order, since the order of the definitions may matter too
+            std::string key = definitions["glob"];
+            for (const auto* proc : program->procs->elements) {
+                if (reached.count("proc " + proc->name)) key += definitions["proc " + proc->name];
+            }
+            for (const auto* func : program->funcs->elements) {
+                if (reached.count("func " + func->name)) key += definitions["func " + func->name];
+            }
+            key += definitions["main"];
+
+            if (!generatedFrom.empty() && key == generatedFrom) {
+                for (size_t i = 0; i < result.outputs.size(); ++i) result.outputs[i].text = generated[i];
+                log << "Reused the generated code: no changed definition reaches main" << std::endl;
+                reused = true;
+            } else if (ast || wholeProgram) {
+                // An AST artifact shows every definition as parsed, and the
+                // phases after it rewrite the tree: it gets a program of its own
+                if (!ast) ast.reset(copyProgram(program));
+                ProgramNode* whole = static_cast<ProgramNode*>(ast.get());
+                generatedFromCount = foldedCount = static_cast<int>(whole->procs->elements.size()
+                                                                     + whole->funcs->elements.size()) + 1;
+                generateOutputs(result, whole, typeChecker, log);
+            } else {
+                // The code comes from folded copies of main and the definitions
+                // it reaches, each made once and kept while its text is: the
+                // definitions themselves stay as parsed
+                BorrowedProgram folded;
+                for (Definition* definition : used) {
+                    if (definition->name != "glob" && !reached.count(definition->name)) continue;
+                    if (!definition->folded) {
+                        definition->folded = foldedCopy(definition->node.get());
+                        if (definition->name != "glob") ++foldedCount;
+                    }
+                    if (definition->name != "glob") ++generatedFromCount;
+                    folded.add(definition->folded.get());
+                }
+                CodeGen codeGen;
+                codeGen.setSymbolTable(&typeChecker.getSymbolTable());
+                codeGen.setSpecializer(specializer.get());
+                generateCode(result, &folded.program, codeGen, log);
+            }
+            if (!reused) {
+                generatedFrom = std::move(key);
+                generated.clear();
+                for (const auto& output : result.outputs) generated.push_back(output.text);
+            }
+        }
+    }
+    result.diagnostics = diagnostics.str();
+    result.log = log.str();
+    return result;
+}
+
+} // namespace splc
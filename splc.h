@@ -0,0 +1,153 @@
+#ifndef SPLC_H
+#define SPLC_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+class Specializer;
+
+/**
+ * @brief The compiler as a library (libsplc): source text in, diagnostics and
+ * generated code out, all in memory. compile() reads and writes no files and
+ * prints nothing; main.cpp is one client of it. compile() may be called from
+ * several threads: the front end (lexer, parser, name checks), which keeps its
+ * state in globals, runs under a lock, and the rest of the pipeline in parallel.
+ */
+namespace splc {
+
+// Goes into cache keys: bump it when a change alters the code generated
+inline constexpr char VERSION[] = "1.0";
+
+// Points of the pipeline an artifact can be taken at, in order
+enum class Stage { PARSED, FOLDED, GENERATED, INLINED, OPTIMIZED, FINAL };
+
+struct Artifact {
+    std::string kind; // ast, ir, html or basic
+    Stage stage;
+    std::string path; // Where the command line writes it, "-" for stdout; compile() ignores it
+};
+
+// Reads KIND[@STAGE][=PATH] (see the README) and fills in the defaults
+bool parseArtifact(const std::string& spec, Artifact& artifact);
+
+struct Options {
+    // Artifacts to produce; none means just the final BASIC program. The
+    // pipeline stops after the last stage one of them is taken from.
+    std::vector<Artifact> artifacts;
+    // Fill in Result::timeReport
+    bool timeReport = false;
+};
+
+// The artifacts compile() produces for options, in the order of Result::outputs
+std::vector<Artifact> planOf(const Options& options);
+
+// Where a compile spent its time: wall and CPU time of each phase (the CPU
+// time is the compiling thread's), and counts of what the phases produced
+struct PhaseTime {
+    std::string phase;
+    double wallMs = 0;
+    double cpuMs = 0;
+};
+
+struct TimeReport {
+    std::vector<PhaseTime> phases;                                // In the order they ran
+    std::vector<std::pair<std::string, unsigned long>> counters; // In the order they were taken
+
+    void addCounter(const std::string& name, unsigned long value) { counters.push_back({name, value}); }
+    // A table for people, or one JSON object for tools
+    std::string toText() const;
+    std::string toJSON() const;
+};
+
+// Times a phase from construction to destruction into report, unless it is nullptr
+class PhaseTimer {
+public:
+    PhaseTimer(TimeReport* report, std::string phase);
+    ~PhaseTimer();
+
+private:
+    TimeReport* report;
+    std::string phase;
+    double wallStart, cpuStart;
+};
+
+struct Output {
+    Artifact artifact;
+    std::string text;
+};
+
+struct Result {
+    bool ok = false;             // Lexed, parsed and type checked
+    std::string diagnostics;     // Lexical, syntax, naming and type errors, one per line
+    std::string log;             // Progress messages of the phases that ran
+    std::vector<Output> outputs; // One per artifact, in the order they were asked for
+    TimeReport timeReport;       // With Options::timeReport; compile() only
+
+    // The first output of that kind, nullptr if there is none
+    const Output* find(const std::string& kind) const;
+};
+
+Result compile(std::string_view source, const Options& options = Options());
+
+/**
+ * Compiles successive versions of one source, as an editor or a file watcher
+ * produces them. An update cuts the source into its definitions (glob, main,
+ * every proc and func) and lexes, parses and name checks only those whose text
+ * is new; the program is then type checked as a whole. The code is generated
+ * from main and the definitions it reaches through calls alone, so when none
+ * of those changed the previous outputs are reused and no later phase runs.
+ * Otherwise the code is generated again for the whole of what main reaches:
+ * calls are inlined, with temporaries, labels and renamed locals numbered
+ * across the program, and the optimizer works on the inlined program, so no
+ * definition has code of its own to keep. What the session keeps per
+ * definition is what comes before that: its folded copy, made when code is
+ * first generated from it, and the copies of its body specialised for
+ * constant arguments. Sources that do not split or parse definition by
+ * definition go through the front end in one piece, which reports their errors
+ * as compile() does.
+ */
+class Session {
+public:
+    explicit Session(Options options = Options());
+    ~Session();
+
+    const Result& update(std::string_view source);
+    const Result& getResult() const { return result; }
+
+    // Definitions that differ from the last version that parsed: "glob",
+    // "main", "proc NAME" or "func NAME"; all of them on the first update
+    const std::vector<std::string>& getChanged() const { return changed; }
+    // Whether the last update reused the outputs instead of generating them
+    bool isReused() const { return reused; }
+    // Definitions (procs, funcs and main) the last update generated code from,
+    // and how many of them it had to fold because no earlier update had
+    int getGeneratedFromCount() const { return generatedFromCount; }
+    int getFoldedCount() const { return foldedCount; }
+
+private:
+    struct Definition;
+
+    Options options;
+    Result result;
+    std::map<std::string, std::unique_ptr<Definition>> parsed; // Kind and text -> its definition
+    std::map<std::string, std::string> definitions;            // Name -> dump of its AST
+    std::vector<std::string> changed;
+    bool reused = false;
+    int generatedFromCount = 0;
+    int foldedCount = 0;
+    std::string generatedFrom;          // Dumps of the definitions the outputs came from
+    std::vector<std::string> generated; // Texts of those outputs
+    std::unique_ptr<Specializer> specializer; // Specialised copies of the kept bodies
+
+    // Fills used with the definitions of source in order, parsing the new
+    // ones; false if it does not split into definitions that parse alone
+    bool reparse(std::string_view source, std::vector<Definition*>& used);
+};
+
+} // namespace splc
+
+#endif // SPLC_H
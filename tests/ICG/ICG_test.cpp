@@ -2,12 +2,23 @@
 #include "doctest.h"
 
 #include "../../Intermediate-Code-Generation/codegen.h"
+#include "../../Intermediate-Code-Generation/const_fold.h"
+#include "../../Intermediate-Code-Generation/evaluator.h"
+#include "../../Intermediate-Code-Generation/optimizer.h"
 #include "../../type_checker.h"
+#include "../../splc.h"
+#include "../../batch.h"
+#include "../../cache.h"
+#include "../../server.h"
 #include "../../ast.h"
 #include "../../spl.tab.hpp"
 //#include "../../lexer_bridge.cpp"
 #include <fstream>
 #include <sstream>
+#include <thread>
+#include <filesystem>
+#include <sys/socket.h>
+#include <unistd.h>
 
 extern AstNode* ast_root;
 extern void initialize_lexer(const std::string& source);
@@ -328,4 +339,856 @@ TEST_CASE("test_do_until_loop.txt") {
 
     delete ast_root;
     ast_root = nullptr;
-}
\ No newline at end of file
+}
+
+TEST_CASE("Test constant folding") {
+    std::string src = readFileToString("tests/ICG/testfiles/constant_folding.txt");
+
+    initialize_lexer(src);
+    int res = yyparse();
+    REQUIRE(ast_root != nullptr);
+
+    TypeChecker typeChecker;
+    bool typeCheckPassed = typeChecker.typeCheck(static_cast<ProgramNode*>(ast_root));
+    REQUIRE(typeCheckPassed);
+
+    ConstantFolder folder;
+    folder.fold(static_cast<ProgramNode*>(ast_root));
+
+    CodeGen codeGen;
+    codeGen.setSymbolTable(&typeChecker.getSymbolTable());
+    codeGen.generate(static_cast<ProgramNode*>(ast_root));
+
+    //codeGen.printCode();
+
+    CHECK(codeGen.toString() ==
+        "LET X1 = 7"
+        "LET t1 = X1"
+        "LET t2 = 7"
+        "LET t3 = (t1 + t2)"
+        "LET Y2 = t3"
+        "LET X1 = Y2"
+        "LET Y2 = X1"
+        "PRINT X1"
+        "STOP"
+    );
+
+    delete ast_root;
+    ast_root = nullptr;
+}
+
+TEST_CASE("Test constant propagation removes the untaken branch") {
+    std::string src = readFileToString("tests/ICG/testfiles/constant_propagation.txt");
+
+    initialize_lexer(src);
+    int res = yyparse();
+    REQUIRE(ast_root != nullptr);
+
+    TypeChecker typeChecker;
+    bool typeCheckPassed = typeChecker.typeCheck(static_cast<ProgramNode*>(ast_root));
+    REQUIRE(typeCheckPassed);
+
+    CodeGen codeGen;
+    codeGen.setSymbolTable(&typeChecker.getSymbolTable());
+    codeGen.generate(static_cast<ProgramNode*>(ast_root));
+    codeGen.performInlining();
+
+    Optimizer optimizer;
+    optimizer.optimize(codeGen.code);
+
+    //codeGen.printCode();
+
+    std::string code = codeGen.toString();
+    CHECK(code.find("PRINT \"big\"") != std::string::npos);
+    CHECK(code.find("PRINT \"small\"") == std::string::npos);
+    CHECK(code.find("LBL_ELSE_2") == std::string::npos);
+    CHECK(code.find("IF ") == std::string::npos);
+
+    delete ast_root;
+    ast_root = nullptr;
+}
+
+TEST_CASE("Test dead code elimination") {
+    std::string src = readFileToString("tests/ICG/testfiles/dead_code.txt");
+
+    initialize_lexer(src);
+    int res = yyparse();
+    REQUIRE(ast_root != nullptr);
+
+    TypeChecker typeChecker;
+    bool typeCheckPassed = typeChecker.typeCheck(static_cast<ProgramNode*>(ast_root));
+    REQUIRE(typeCheckPassed);
+
+    CodeGen codeGen;
+    codeGen.setSymbolTable(&typeChecker.getSymbolTable());
+    codeGen.generate(static_cast<ProgramNode*>(ast_root));
+    codeGen.performInlining();
+
+    Optimizer optimizer;
+    optimizer.optimize(codeGen.code);
+
+    //codeGen.printCode();
+
+    // Only the print of x survives; y, z and every temp are never read
+    CHECK(codeGen.toString() ==
+        "PRINT 5"
+        "STOP"
+    );
+    CHECK(optimizer.getStats().deadStoresRemoved > 0);
+
+    delete ast_root;
+    ast_root = nullptr;
+}
+
+TEST_CASE("Test peephole straightens loop control flow") {
+    std::string src = readFileToString("tests/ICG/testfiles/while_print.txt");
+
+    initialize_lexer(src);
+    int res = yyparse();
+    REQUIRE(ast_root != nullptr);
+
+    TypeChecker typeChecker;
+    bool typeCheckPassed = typeChecker.typeCheck(static_cast<ProgramNode*>(ast_root));
+    REQUIRE(typeCheckPassed);
+
+    CodeGen codeGen;
+    codeGen.setSymbolTable(&typeChecker.getSymbolTable());
+    codeGen.generate(static_cast<ProgramNode*>(ast_root));
+    codeGen.performInlining();
+
+    Optimizer optimizer;
+    optimizer.optimize(codeGen.code);
+    codeGen.startPostProcess();
+
+    //codeGen.printCode();
+
+    // The entry test falls through into the body, which tests again at the bottom
+    CHECK(codeGen.toString() ==
+        "10 IF 100 <= X1 THEN 50"
+        "20 PRINT X1"
+        "30 LET X1 = (X1 + 1)"
+        "40 IF 100 > X1 THEN 20"
+        "50 PRINT \"Heybrother\""
+        "60 STOP"
+    );
+
+    delete ast_root;
+    ast_root = nullptr;
+}
+
+TEST_CASE("Test function specialisation on constant arguments") {
+    std::string src = readFileToString("tests/ICG/testfiles/specialization.txt");
+
+    initialize_lexer(src);
+    int res = yyparse();
+    REQUIRE(ast_root != nullptr);
+
+    TypeChecker typeChecker;
+    bool typeCheckPassed = typeChecker.typeCheck(static_cast<ProgramNode*>(ast_root));
+    REQUIRE(typeCheckPassed);
+
+    CodeGen codeGen;
+    codeGen.setSymbolTable(&typeChecker.getSymbolTable());
+    codeGen.generate(static_cast<ProgramNode*>(ast_root));
+    codeGen.performInlining();
+
+    //codeGen.printCode();
+
+    // Both scale(3) calls share one folded copy: no test of n and no report
+    // call; only scale(x) still branches and inlines report
+    int tests = 0, prints = 0;
+    for (const auto& line : codeGen.code) {
+        if (line.rfind("IF ", 0) == 0) ++tests;
+        if (line.rfind("PRINT ", 0) == 0) ++prints;
+    }
+    CHECK(codeGen.getSpecializationCount() == 1);
+    CHECK(tests == 1);
+    CHECK(prints == 4);
+
+    delete ast_root;
+    ast_root = nullptr;
+}
+
+TEST_CASE("Test compile-time evaluation") {
+    std::string src = readFileToString("tests/ICG/testfiles/evaluation.txt");
+
+    initialize_lexer(src);
+    int res = yyparse();
+    REQUIRE(ast_root != nullptr);
+
+    TypeChecker typeChecker;
+    bool typeCheckPassed = typeChecker.typeCheck(static_cast<ProgramNode*>(ast_root));
+    REQUIRE(typeCheckPassed);
+
+    Evaluator evaluator;
+    CHECK(evaluator.evaluate(static_cast<ProgramNode*>(ast_root)));
+
+    CodeGen codeGen;
+    codeGen.setSymbolTable(&typeChecker.getSymbolTable());
+    codeGen.generate(static_cast<ProgramNode*>(ast_root), &evaluator);
+    codeGen.performInlining();
+
+    //codeGen.printCode();
+
+    // The whole program is its output
+    CHECK(codeGen.toString() ==
+        "PRINT \"fact\""
+        "PRINT 5"
+        "PRINT 120"
+        "STOP"
+    );
+
+    delete ast_root;
+    ast_root = nullptr;
+}
+
+TEST_CASE("Test compile-time evaluation of a prefix") {
+    std::string src = readFileToString("tests/ICG/testfiles/evaluation_prefix.txt");
+
+    initialize_lexer(src);
+    int res = yyparse();
+    REQUIRE(ast_root != nullptr);
+
+    TypeChecker typeChecker;
+    bool typeCheckPassed = typeChecker.typeCheck(static_cast<ProgramNode*>(ast_root));
+    REQUIRE(typeCheckPassed);
+
+    // x is never assigned, so evaluation stops at the IF
+    Evaluator evaluator;
+    CHECK_FALSE(evaluator.evaluate(static_cast<ProgramNode*>(ast_root)));
+    CHECK(evaluator.getEvaluatedCount() == 3);
+
+    CodeGen codeGen;
+    codeGen.setSymbolTable(&typeChecker.getSymbolTable());
+    codeGen.generate(static_cast<ProgramNode*>(ast_root), &evaluator);
+
+    //codeGen.printCode();
+
+    // The first three statements become their output and the values they left
+    CHECK(codeGen.code.size() > 3);
+    CHECK(codeGen.code[0] == "PRINT 42");
+    CHECK(codeGen.code[1] == "LET A1 = 6");
+    CHECK(codeGen.code[2] == "LET B2 = 42");
+
+    delete ast_root;
+    ast_root = nullptr;
+}
+
+TEST_CASE("Test short-circuit conditions") {
+    std::string src = readFileToString("tests/ICG/testfiles/short_circuit.txt");
+
+    initialize_lexer(src);
+    int res = yyparse();
+    REQUIRE(ast_root != nullptr);
+
+    TypeChecker typeChecker;
+    bool typeCheckPassed = typeChecker.typeCheck(static_cast<ProgramNode*>(ast_root));
+    REQUIRE(typeCheckPassed);
+
+    CodeGen codeGen;
+    codeGen.setSymbolTable(&typeChecker.getSymbolTable());
+    codeGen.generate(static_cast<ProgramNode*>(ast_root));
+
+    //codeGen.printCode();
+
+    // No boolean temps: the right operand is only reached if x > 5
+    CHECK(codeGen.toString() ==
+        "LET t1 = X1"
+        "LET t2 = 5"
+        "IF t1 > t2 THEN LBL_AND_4"
+        "GOTO LBL_ELSE_2"
+        "REM LBL_AND_4"
+        "LET t3 = Y2"
+        "LET t4 = 5"
+        "IF t3 = t4 THEN LBL_ELSE_2"
+        "GOTO LBL_THEN_1"
+        "REM LBL_ELSE_2"
+        "PRINT Y2"
+        "GOTO LBL_EXIT_3"
+        "REM LBL_THEN_1"
+        "PRINT X1"
+        "REM LBL_EXIT_3"
+        "STOP"
+    );
+
+    delete ast_root;
+    ast_root = nullptr;
+}
+
+TEST_CASE("Test variable coalescing") {
+    std::string src = readFileToString("tests/ICG/testfiles/coalescing.txt");
+
+    initialize_lexer(src);
+    int res = yyparse();
+    REQUIRE(ast_root != nullptr);
+
+    TypeChecker typeChecker;
+    bool typeCheckPassed = typeChecker.typeCheck(static_cast<ProgramNode*>(ast_root));
+    REQUIRE(typeCheckPassed);
+
+    CodeGen codeGen;
+    codeGen.setSymbolTable(&typeChecker.getSymbolTable());
+    codeGen.generate(static_cast<ProgramNode*>(ast_root));
+    codeGen.performInlining();
+
+    Optimizer optimizer;
+    optimizer.optimize(codeGen.code);
+
+    //codeGen.printCode();
+
+    // a, b and every temp fold into two names: x dies where b is computed
+    CHECK(codeGen.toString() ==
+        "LET t3 = (X2 + 1)"
+        "PRINT t3"
+        "LET X2 = (X2 + 2)"
+        "PRINT X2"
+        "STOP"
+    );
+    CHECK(optimizer.getStats().variablesAfter < optimizer.getStats().variablesBefore);
+
+    delete ast_root;
+    ast_root = nullptr;
+}
+
+TEST_CASE("Test global value numbering") {
+    std::string src = readFileToString("tests/ICG/testfiles/value_numbering.txt");
+
+    initialize_lexer(src);
+    int res = yyparse();
+    REQUIRE(ast_root != nullptr);
+
+    TypeChecker typeChecker;
+    bool typeCheckPassed = typeChecker.typeCheck(static_cast<ProgramNode*>(ast_root));
+    REQUIRE(typeCheckPassed);
+
+    CodeGen codeGen;
+    codeGen.setSymbolTable(&typeChecker.getSymbolTable());
+    codeGen.generate(static_cast<ProgramNode*>(ast_root));
+    codeGen.performInlining();
+
+    Optimizer optimizer;
+    optimizer.optimize(codeGen.code);
+
+    //codeGen.printCode();
+
+    // Both branches recompute a + b, so y is x and the IF has nothing left to choose
+    CHECK(codeGen.toString() ==
+        "LET A2 = (A2 + B3)"
+        "PRINT A2"
+        "PRINT A2"
+        "STOP"
+    );
+    CHECK(optimizer.getStats().redundantRemoved == 2);
+
+    delete ast_root;
+    ast_root = nullptr;
+}
+
+TEST_CASE("Test loop-invariant code motion") {
+    std::string src = readFileToString("tests/ICG/testfiles/loop_invariant.txt");
+
+    initialize_lexer(src);
+    int res = yyparse();
+    REQUIRE(ast_root != nullptr);
+
+    TypeChecker typeChecker;
+    bool typeCheckPassed = typeChecker.typeCheck(static_cast<ProgramNode*>(ast_root));
+    REQUIRE(typeCheckPassed);
+
+    CodeGen codeGen;
+    codeGen.setSymbolTable(&typeChecker.getSymbolTable());
+    codeGen.generate(static_cast<ProgramNode*>(ast_root));
+    codeGen.performInlining();
+
+    Optimizer optimizer;
+    optimizer.optimize(codeGen.code);
+    codeGen.startPostProcess();
+
+    //codeGen.printCode();
+
+    // a * b is computed once, between the entry test and the loop
+    CHECK(codeGen.toString() ==
+        "10 IF N2 <= 0 THEN 70"
+        "20 LET t11 = 0"
+        "30 LET A4 = (A4 * B5)"
+        "40 PRINT A4"
+        "50 LET t11 = (t11 + 1)"
+        "60 IF N2 > t11 THEN 40"
+        "70 STOP"
+    );
+    CHECK(optimizer.getStats().invariantsHoisted == 1);
+
+    delete ast_root;
+    ast_root = nullptr;
+}
+
+TEST_CASE("Test loop unswitching") {
+    std::string src = readFileToString("tests/ICG/testfiles/unswitch.txt");
+
+    initialize_lexer(src);
+    int res = yyparse();
+    REQUIRE(ast_root != nullptr);
+
+    TypeChecker typeChecker;
+    bool typeCheckPassed = typeChecker.typeCheck(static_cast<ProgramNode*>(ast_root));
+    REQUIRE(typeCheckPassed);
+
+    CodeGen codeGen;
+    codeGen.setSymbolTable(&typeChecker.getSymbolTable());
+    codeGen.generate(static_cast<ProgramNode*>(ast_root));
+    codeGen.performInlining();
+
+    Optimizer optimizer;
+    optimizer.optimize(codeGen.code);
+    codeGen.startPostProcess();
+
+    //codeGen.printCode();
+
+    // flag is tested once; each copy of the loop prints without a branch
+    CHECK(codeGen.toString() ==
+        "10 IF N2 <= 0 THEN 70"
+        "20 LET t10 = 0"
+        "30 IF F3 > 0 THEN 80"
+        "40 PRINT \"off\""
+        "50 LET t10 = (t10 + 1)"
+        "60 IF N2 > t10 THEN 40"
+        "70 STOP"
+        "80 PRINT t10"
+        "90 LET t10 = (t10 + 1)"
+        "100 IF N2 > t10 THEN 80"
+        "110 STOP"
+    );
+    CHECK(optimizer.getStats().loopsUnswitched == 1);
+
+    delete ast_root;
+    ast_root = nullptr;
+}
+
+TEST_CASE("Test value-range comparison folding") {
+    std::string src = readFileToString("tests/ICG/testfiles/value_ranges.txt");
+
+    initialize_lexer(src);
+    int res = yyparse();
+    REQUIRE(ast_root != nullptr);
+
+    TypeChecker typeChecker;
+    bool typeCheckPassed = typeChecker.typeCheck(static_cast<ProgramNode*>(ast_root));
+    REQUIRE(typeCheckPassed);
+
+    CodeGen codeGen;
+    codeGen.setSymbolTable(&typeChecker.getSymbolTable());
+    codeGen.generate(static_cast<ProgramNode*>(ast_root));
+    codeGen.performInlining();
+
+    Optimizer optimizer;
+    optimizer.optimize(codeGen.code);
+    codeGen.startPostProcess();
+
+    //codeGen.printCode();
+
+    // i starts at 1 and only grows, and x is known to be 5 inside the first if
+    CHECK(codeGen.toString() ==
+        "10 IF N2 <= 1 THEN 60"
+        "20 LET t14 = 1"
+        "30 PRINT t14"
+        "40 LET t14 = (t14 + 1)"
+        "50 IF N2 > t14 THEN 30"
+        "60 IF X3 = 5 THEN 90"
+        "70 PRINT \"other\""
+        "80 STOP"
+        "90 PRINT X3"
+        "100 STOP"
+    );
+    CHECK(optimizer.getStats().comparisonsFolded == 2);
+
+    delete ast_root;
+    ast_root = nullptr;
+}
+
+TEST_CASE("Test induction variable optimisation") {
+    std::string src = readFileToString("tests/ICG/testfiles/induction.txt");
+
+    initialize_lexer(src);
+    int res = yyparse();
+    REQUIRE(ast_root != nullptr);
+
+    TypeChecker typeChecker;
+    bool typeCheckPassed = typeChecker.typeCheck(static_cast<ProgramNode*>(ast_root));
+    REQUIRE(typeCheckPassed);
+
+    CodeGen codeGen;
+    codeGen.setSymbolTable(&typeChecker.getSymbolTable());
+    codeGen.generate(static_cast<ProgramNode*>(ast_root));
+    codeGen.performInlining();
+
+    Optimizer optimizer;
+    optimizer.optimize(codeGen.code);
+    codeGen.startPostProcess();
+
+    //codeGen.printCode();
+
+    // The sum loop becomes 3 * (n*i + n*(n-1)/2); the printing loop steps k by 4
+    CHECK(codeGen.toString() ==
+        "10 IF N1 <= 1000 THEN 30"
+        "20 LET N1 = 1000"
+        "30 LET t32 = 0"
+        "40 IF N1 <= 0 THEN 140"
+        "50 IF 1 >= N1 THEN 140"
+        "60 LET t36 = (N1 - 1)"
+        "70 LET t37 = (t36 - 1)"
+        "80 LET t37 = (t37 * t36)"
+        "90 LET t37 = (t37 / 2)"
+        "100 LET t38 = t36"
+        "110 LET t38 = (t38 + t37)"
+        "120 LET t38 = (t38 * 3)"
+        "130 LET t32 = t38"
+        "140 PRINT t32"
+        "150 IF N1 <= 0 THEN 220"
+        "160 LET t32 = 0"
+        "170 LET t28 = 0"
+        "180 PRINT t28"
+        "190 LET t32 = (t32 + 1)"
+        "200 LET t28 = (t28 + 4)"
+        "210 IF N1 > t32 THEN 180"
+        "220 STOP"
+    );
+    CHECK(optimizer.getStats().loopsReplaced == 1);
+    CHECK(optimizer.getStats().multiplicationsReduced == 1);
+
+    delete ast_root;
+    ast_root = nullptr;
+
+    src = readFileToString("tests/ICG/testfiles/induction_limits.txt");
+    initialize_lexer(src);
+    res = yyparse();
+    REQUIRE(ast_root != nullptr);
+
+    TypeChecker limitsChecker;
+    REQUIRE(limitsChecker.typeCheck(static_cast<ProgramNode*>(ast_root)));
+
+    CodeGen limitsGen;
+    limitsGen.setSymbolTable(&limitsChecker.getSymbolTable());
+    limitsGen.generate(static_cast<ProgramNode*>(ast_root));
+    limitsGen.performInlining();
+
+    Optimizer limitsOptimizer;
+    limitsOptimizer.optimize(limitsGen.code);
+    limitsGen.startPostProcess();
+
+    // n <= 46000: 45999*45998 is still in the integer range, so the sum loop
+    // goes. The loop that may divide by zero stays.
+    CHECK(limitsGen.toString() ==
+        "10 IF N1 <= 46000 THEN 30"
+        "20 LET N1 = 46000"
+        "30 LET t32 = 0"
+        "40 IF N1 <= 0 THEN 130"
+        "50 IF 1 >= N1 THEN 130"
+        "60 LET t36 = (N1 - 1)"
+        "70 LET t37 = (t36 - 1)"
+        "80 LET t37 = (t37 * t36)"
+        "90 LET t37 = (t37 / 2)"
+        "100 LET t38 = t36"
+        "110 LET t38 = (t38 + t37)"
+        "120 LET t32 = t38"
+        "130 PRINT t32"
+        "140 IF N1 <= 0 THEN 200"
+        "150 LET t32 = 0"
+        "160 LET t28 = (t32 - 3)"
+        "170 LET t28 = (0 / t28)"
+        "180 LET t32 = (t32 + 1)"
+        "190 IF N1 > t32 THEN 160"
+        "200 STOP"
+    );
+    CHECK(limitsOptimizer.getStats().loopsReplaced == 1);
+
+    delete ast_root;
+    ast_root = nullptr;
+}
+
+TEST_CASE("Test loop unrolling") {
+    std::string src = readFileToString("tests/ICG/testfiles/unroll.txt");
+
+    initialize_lexer(src);
+    int res = yyparse();
+    REQUIRE(ast_root != nullptr);
+
+    TypeChecker typeChecker;
+    bool typeCheckPassed = typeChecker.typeCheck(static_cast<ProgramNode*>(ast_root));
+    REQUIRE(typeCheckPassed);
+
+    CodeGen codeGen;
+    codeGen.setSymbolTable(&typeChecker.getSymbolTable());
+    codeGen.generate(static_cast<ProgramNode*>(ast_root));
+    codeGen.performInlining();
+
+    Optimizer optimizer;
+    optimizer.optimize(codeGen.code);
+    codeGen.startPostProcess();
+
+    //codeGen.printCode();
+
+    // Four doublings are unrolled and folded; the 30 prints run 4 per test after 2 peeled ones
+    CHECK(codeGen.toString() ==
+        "10 PRINT 16"
+        "20 PRINT 0"
+        "30 PRINT 1"
+        "40 LET t18 = 2"
+        "50 IF t18 >= 30 THEN 150"
+        "60 PRINT t18"
+        "70 LET t18 = (t18 + 1)"
+        "80 PRINT t18"
+        "90 LET t18 = (t18 + 1)"
+        "100 PRINT t18"
+        "110 LET t18 = (t18 + 1)"
+        "120 PRINT t18"
+        "130 LET t18 = (t18 + 1)"
+        "140 GOTO 50"
+        "150 STOP"
+    );
+    CHECK(optimizer.getStats().loopsUnrolled == 1);
+    CHECK(optimizer.getStats().loopsUnrolledPartially == 1);
+
+    delete ast_root;
+    ast_root = nullptr;
+}
+
+TEST_CASE("Test in-memory compile API") {
+    std::string src = readFileToString("tests/ICG/testfiles/evaluation_prefix.txt");
+
+    splc::Options options;
+    splc::Artifact ir, basic;
+    REQUIRE(splc::parseArtifact("ir@generated", ir));
+    REQUIRE(splc::parseArtifact("basic", basic));
+    options.artifacts = {ir, basic};
+
+    // Compiles are independent: the same source gives the same program again
+    splc::Result first = splc::compile(src, options);
+    splc::Result second = splc::compile(src, options);
+    REQUIRE(first.ok);
+    CHECK(first.diagnostics.empty());
+    REQUIRE(first.outputs.size() == 2);
+    CHECK(first.outputs[0].text.rfind("PRINT 42\n", 0) == 0);
+    REQUIRE(first.find("basic") != nullptr);
+    CHECK(first.find("basic")->text.rfind("10 PRINT 42\n", 0) == 0);
+    CHECK(second.find("basic")->text == first.find("basic")->text);
+
+    // Errors come back as diagnostics, with no artifacts rendered
+    splc::Result syntax = splc::compile("glob { } proc { } func { } main { var { } print }");
+    CHECK_FALSE(syntax.ok);
+    CHECK(syntax.diagnostics.find("Syntax Error") != std::string::npos);
+    CHECK(syntax.outputs[0].text.empty());
+
+    splc::Result lexical = splc::compile("glob { } proc { } func { } main { var { } print 007 }");
+    CHECK_FALSE(lexical.ok);
+    CHECK(lexical.diagnostics.find("Lexical error") != std::string::npos);
+}
+
+TEST_CASE("Test concurrent compiles") {
+    std::vector<std::string> sources = {
+        readFileToString("tests/ICG/testfiles/unroll.txt"),
+        readFileToString("tests/ICG/testfiles/specialization.txt"),
+        readFileToString("tests/ICG/testfiles/evaluation.txt"),
+        readFileToString("tests/ICG/testfiles/induction.txt"),
+    };
+    std::vector<std::string> expected;
+    for (const auto& src : sources) expected.push_back(splc::compile(src).outputs[0].text);
+
+    // Every thread compiles every source, starting at a different one
+    std::vector<std::vector<std::string>> results(4);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < results.size(); ++t) {
+        threads.emplace_back([&, t] {
+            for (size_t i = 0; i < sources.size(); ++i) {
+                results[t].push_back(splc::compile(sources[(t + i) % sources.size()]).outputs[0].text);
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    for (size_t t = 0; t < results.size(); ++t) {
+        for (size_t i = 0; i < sources.size(); ++i) {
+            CHECK(results[t][i] == expected[(t + i) % sources.size()]);
+        }
+    }
+
+    CHECK(outputPathFor("%.bas", "tests/a.txt") == "tests/a.bas");
+    CHECK(outputPathFor("out/%.ir", "dir.v2/prog") == "out/dir.v2/prog.ir");
+}
+
+TEST_CASE("Test compile cache") {
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() / "splc_cache_test";
+    fs::remove_all(dir);
+    std::string source = readFileToString("tests/ICG/testfiles/unroll.txt");
+    std::string broken = "glob { x } proc { } func { } main { var { } print y }";
+    splc::Options options;
+    options.artifacts.push_back({"ir", splc::Stage::GENERATED, "-"});
+    options.artifacts.push_back({"basic", splc::Stage::FINAL, "-"});
+
+    {
+        CompileCache cache(dir.string(), 1 << 20);
+        REQUIRE(cache.isUsable());
+        std::string key = cache.keyFor(source, options);
+        CHECK(key.size() == 32);
+        CHECK(key != cache.keyFor(source, splc::Options()));
+        CHECK(key != cache.keyFor(source + " ", options));
+
+        splc::Result fresh = compileCached(source, options, &cache);
+        splc::Result reused = compileCached(source, options, &cache);
+        REQUIRE(reused.outputs.size() == 2);
+        CHECK(reused.ok);
+        CHECK(reused.outputs[0].text == fresh.outputs[0].text);
+        CHECK(reused.outputs[1].text == fresh.outputs[1].text);
+        CHECK(reused.log.find("Reused the cached result " + key) != std::string::npos);
+
+        // Rejected programs are cached with their diagnostics
+        splc::Result rejected = compileCached(broken, splc::Options(), &cache);
+        splc::Result again = compileCached(broken, splc::Options(), &cache);
+        CHECK(!again.ok);
+        CHECK(again.diagnostics == rejected.diagnostics);
+
+        // A damaged entry is a miss, and is replaced
+        std::ofstream(dir / (key + ".entry")) << "splc-cache 1\n1\n99\nshort";
+        splc::Result recompiled = compileCached(source, options, &cache);
+        CHECK(recompiled.log.find("Reused") == std::string::npos);
+        CHECK(recompiled.outputs[1].text == fresh.outputs[1].text);
+    }
+
+    // Just over the bound: the least recently used entry goes, the other stays
+    {
+        CompileCache probe(dir.string(), 1 << 20);
+        fs::path older = dir / (probe.keyFor(source, options) + ".entry");
+        fs::path newer = dir / (probe.keyFor(broken, splc::Options()) + ".entry");
+        fs::last_write_time(older, fs::file_time_type::clock::now() - std::chrono::hours(1));
+        CompileCache cache(dir.string(), fs::file_size(older) + fs::file_size(newer) - 1);
+        cache.trim();
+        CHECK(!fs::exists(older));
+        CHECK(fs::exists(newer));
+    }
+    fs::remove_all(dir);
+}
+
+TEST_CASE("Test compile server") {
+    std::string source = readFileToString("tests/ICG/testfiles/unroll.txt");
+    std::string broken = "glob { x } proc { } func { } main { var { } print y }";
+    splc::Options options;
+    options.artifacts.push_back({"ir", splc::Stage::GENERATED, "-"});
+    options.artifacts.push_back({"basic", splc::Stage::FINAL, "-"});
+
+    int ends[2];
+    REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, ends) == 0);
+    std::thread server(serveConnection, ends[1], nullptr);
+
+    // One connection carries any number of requests, each answered with the
+    // Result an in-process compile gives
+    splc::Result local = splc::compile(source, options);
+    splc::Result remote;
+    REQUIRE(compileOver(ends[0], source, options, remote));
+    CHECK(remote.ok == local.ok);
+    CHECK(remote.diagnostics == local.diagnostics);
+    CHECK(remote.log == local.log);
+    REQUIRE(remote.outputs.size() == local.outputs.size());
+    for (size_t i = 0; i < local.outputs.size(); ++i) {
+        CHECK(remote.outputs[i].artifact.kind == local.outputs[i].artifact.kind);
+        CHECK(remote.outputs[i].text == local.outputs[i].text);
+    }
+
+    splc::Result rejected;
+    REQUIRE(compileOver(ends[0], broken, splc::Options(), rejected));
+    CHECK_FALSE(rejected.ok);
+    CHECK(rejected.diagnostics == splc::compile(broken).diagnostics);
+
+    ::close(ends[0]);
+    server.join();
+
+    // With no server to answer, the result is left alone for a local compile
+    splc::Result untouched;
+    untouched.log = "unchanged";
+    CHECK_FALSE(compileRemote("/nonexistent/splc.sock", source, options, untouched));
+    CHECK(untouched.log == "unchanged");
+}
+
+TEST_CASE("Test incremental session") {
+    std::string source = readFileToString("tests/ICG/testfiles/specialization.txt");
+    auto edited = [&](const std::string& from, const std::string& to) {
+        std::string text = source;
+        size_t at = text.find(from);
+        REQUIRE(at != std::string::npos);
+        return text.replace(at, from.size(), to);
+    };
+    auto sameAsCompile = [](const splc::Result& result, const std::string& text) {
+        splc::Result expected = splc::compile(text);
+        CHECK(result.ok == expected.ok);
+        CHECK(result.diagnostics == expected.diagnostics);
+        CHECK(result.outputs[0].text == expected.outputs[0].text);
+    };
+
+    splc::Session session;
+    sameAsCompile(session.update(source), source);
+    CHECK(!session.isReused());
+    CHECK(session.getChanged().size() == 4); // glob, report, scale and main
+    CHECK(session.getFoldedCount() == session.getGeneratedFromCount());
+
+    // Only layout changed: nothing to regenerate
+    std::string spaced = edited("print code", "print   code");
+    sameAsCompile(session.update(spaced), spaced);
+    CHECK(session.isReused());
+    CHECK(session.getChanged().empty());
+
+    // A proc nothing calls
+    std::string unused = edited("proc {", "proc {\n    spare(q) {\n        local { }\n        print q\n    }");
+    sameAsCompile(session.update(unused), unused);
+    CHECK(session.isReused());
+    REQUIRE(session.getChanged().size() == 1);
+    CHECK(session.getChanged()[0] == "proc spare");
+
+    // A func main calls
+    std::string scaled = edited("r = (n mult 100)", "r = (n mult 10)");
+    sameAsCompile(session.update(scaled), scaled);
+    CHECK(!session.isReused());
+    CHECK(session.getChanged().size() == 2); // scale changed, spare is gone
+    CHECK(session.getGeneratedFromCount() == 3); // report, scale and main
+    CHECK(session.getFoldedCount() == 2);        // scale, and report whose text was respaced since its last fold
+
+    // Syntax errors are reported as for the whole source, then recovered from
+    std::string broken = edited("print a;", "print a");
+    sameAsCompile(session.update(broken), broken);
+    sameAsCompile(session.update(source), source);
+    CHECK(!session.isReused());
+}
+
+TEST_CASE("Test time report") {
+    std::string source = readFileToString("tests/ICG/testfiles/specialization.txt");
+    CHECK(splc::compile(source).timeReport.phases.empty());
+
+    splc::Options options;
+    options.timeReport = true;
+    splc::Result result = splc::compile(source, options);
+    REQUIRE(result.ok);
+    std::vector<std::string> phases;
+    for (const auto& phase : result.timeReport.phases) {
+        phases.push_back(phase.phase);
+        CHECK(phase.wallMs >= 0);
+        CHECK(phase.cpuMs >= 0);
+    }
+    CHECK(phases == std::vector<std::string>{"lex", "parse", "checkNames", "typeCheck", "fold", "evaluate",
+                                             "generate", "performInlining", "optimize", "startPostProcess",
+                                             "render basic@final"});
+
+    auto counter = [&](const std::string& name) {
+        for (const auto& [key, value] : result.timeReport.counters) {
+            if (key == name) return static_cast<long>(value);
+        }
+        return -1L;
+    };
+    CHECK(counter("tokens") == 104);
+    CHECK(counter("ast_nodes") > 0);
+    CHECK(counter("symbols") >= 6); // a b c x, report, scale, and their parameters and locals
+    CHECK(counter("instructions_inlined") >= counter("instructions_generated"));
+    CHECK(counter("inlining_passes") >= 1);
+    CHECK(counter("labels") >= 0);
+
+    std::string json = result.timeReport.toJSON();
+    CHECK(json.rfind("{\"phases\":[{\"phase\":\"lex\",\"wall_ms\":", 0) == 0);
+    CHECK(json.find("\"counters\":{\"tokens\":104,") != std::string::npos);
+    CHECK(result.timeReport.toText().find("total") != std::string::npos);
+}
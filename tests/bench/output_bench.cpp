@@ -0,0 +1,87 @@
+// Output benchmark: time to write BASIC_EXECUTABLE.txt and ICG.html for large
+// generated programs, the old way (std::endl per line, HTML through a
+// stringstream) against OutputWriter.
+//
+//   make bench            (or ./output_bench [lines...])
+
+#include "../../Intermediate-Code-Generation/codegen.h"
+#include "../../Intermediate-Code-Generation/writer.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static const char* CODE_FILE = "bench_code.txt";
+static const char* HTML_FILE = "bench_code.html";
+
+// A program of about the given number of lines in the shape CodeGen produces
+// after inlining: assignments, PRINTs and loops with labels and jumps
+static std::vector<std::string> makeProgram(size_t lines) {
+    std::vector<std::string> code;
+    code.reserve(lines);
+    for (size_t loop = 0; code.size() < lines; ++loop) {
+        std::string label = "LBL_WHILE_" + std::to_string(loop);
+        std::string var = "V" + std::to_string(loop % 97);
+        code.push_back("LET " + var + " = 0");
+        code.push_back("REM " + label);
+        code.push_back("LET t1 = " + var + " * 3");
+        code.push_back("LET " + var + " = " + var + " + 1");
+        code.push_back("PRINT t1");
+        code.push_back("IF " + var + " < 10 THEN " + label);
+    }
+    return code;
+}
+
+template <typename F>
+static double seconds(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void writeEndlPerLine(const std::vector<std::string>& code) {
+    std::ofstream outputFile(CODE_FILE);
+    for (const auto& line : code) outputFile << line << std::endl;
+}
+
+static void writeHTMLThroughStringstream(const std::vector<std::string>& code) {
+    std::stringstream htmlContent;
+    htmlContent << "<!DOCTYPE html>\n<html>\n<head><title>Generated BASIC Code</title></head>\n"
+                << "<body>\n<h1>Generated BASIC Code</h1>\n<pre><code>\n";
+    for (const std::string& line : code) htmlContent << line << "\n";
+    htmlContent << "</code></pre>\n</body>\n</html>\n";
+    std::ofstream outputFile(HTML_FILE);
+    outputFile << htmlContent.str();
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<size_t> sizes;
+    for (int i = 1; i < argc; ++i) sizes.push_back(std::strtoul(argv[i], nullptr, 10));
+    if (sizes.empty()) sizes = {100000, 1000000, 4000000};
+
+    std::printf("%10s %12s %12s %12s %12s %12s\n", "lines", "postprocess", "endl", "writer", "html-sstream", "html-writer");
+    for (size_t lines : sizes) {
+        CodeGen codeGen;
+        codeGen.code = makeProgram(lines);
+        double post = seconds([&] { codeGen.startPostProcess(); });
+
+        double endl = seconds([&] { writeEndlPerLine(codeGen.code); });
+        double writer = seconds([&] {
+            OutputWriter out(CODE_FILE);
+            codeGen.writeCode(out);
+            out.close();
+        });
+        double htmlOld = seconds([&] { writeHTMLThroughStringstream(codeGen.code); });
+        double htmlNew = seconds([&] {
+            OutputWriter out(HTML_FILE);
+            codeGen.writeHTML(out);
+            out.close();
+        });
+        std::printf("%10zu %11.3fs %11.3fs %11.3fs %11.3fs %11.3fs\n", codeGen.code.size(), post, endl, writer, htmlOld, htmlNew);
+    }
+    std::remove(CODE_FILE);
+    std::remove(HTML_FILE);
+    return 0;
+}
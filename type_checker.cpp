@@ -47,6 +47,7 @@ bool SymbolTable::declare(const std::string& name, Type type) {
     }
     
     scopes.back()[name] = type;
+    ++declaredCount;
     return true;
 }
 
@@ -24,6 +24,7 @@ class SymbolTable {
 private:
     std::unordered_map<std::string, Type> symbols;
     std::vector<std::unordered_map<std::string, Type>> scopes; // For nested scopes
+    size_t declaredCount = 0; // Every declaration that succeeded, in any scope
     
 public:
     SymbolTable();
@@ -45,6 +46,7 @@ public:
     std::unordered_map<std::string, Type> getSymbols() const;
     //getter for scopes
     const std::vector<std::unordered_map<std::string, Type>>& getScopes() const;
+    size_t getDeclaredCount() const { return declaredCount; }
 
 };
 
@@ -0,0 +1,101 @@
+#include "watch.h"
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+// Saves come as bursts of events (truncate, write, close, rename): after the
+// first, events are taken until the input has been quiet this long
+static const int SETTLE_MS = 20;
+
+// Reads all pending events; true if one of them is about the file called name
+static bool drainEvents(int fd, const std::string& name) {
+    alignas(inotify_event) char buffer[16 * (sizeof(inotify_event) + NAME_MAX + 1)];
+    bool touched = false;
+    while (true) {
+        ssize_t length = ::read(fd, buffer, sizeof(buffer));
+        if (length <= 0) return touched; // EAGAIN: nothing more for now
+        for (char* p = buffer; p < buffer + length;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+            if (event->len > 0 && name == event->name) touched = true;
+            p += sizeof(inotify_event) + event->len;
+        }
+    }
+}
+
+static bool readSource(const std::string& path, std::string& source) {
+    std::ifstream inputFile(path);
+    if (!inputFile.is_open()) return false;
+    std::stringstream buffer;
+    buffer << inputFile.rdbuf();
+    source = buffer.str();
+    return true;
+}
+
+int watch(const std::string& input, const splc::Options& options,
+          const std::function<void(const splc::Result&)>& deliver) {
+    size_t slash = input.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : input.substr(0, slash == 0 ? 1 : slash);
+    std::string name = slash == std::string::npos ? input : input.substr(slash + 1);
+
+    int fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0 || ::inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+        std::cerr << "Could not watch " << directory << ": " << std::strerror(errno) << std::endl;
+        if (fd >= 0) ::close(fd);
+        return 1;
+    }
+
+    splc::Session session(options);
+    std::string compiled; // The source the session last saw
+    bool first = true;
+    while (true) {
+        std::string source;
+        if (!readSource(input, source)) {
+            std::cerr << "Could not open file: " << input << std::endl;
+        } else if (first || source != compiled) {
+            auto start = std::chrono::steady_clock::now();
+            const splc::Result& result = session.update(source);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            compiled = std::move(source);
+            first = false;
+
+            deliver(result);
+            std::cout << "Compiled " << input << " in " << ms << " ms";
+            if (!result.ok) {
+                std::cout << ": rejected";
+            } else {
+                if (session.isReused()) {
+                    std::cout << ", code reused";
+                } else {
+                    // Code is never regenerated per definition: inlining and the optimizer see the whole program
+                    int from = session.getGeneratedFromCount();
+                    std::cout << ", code regenerated whole from " << from << (from == 1 ? " definition" : " definitions")
+                              << ", " << session.getFoldedCount() << " newly folded";
+                }
+                const auto& changed = session.getChanged();
+                for (size_t i = 0; i < changed.size() && i < 8; ++i) std::cout << (i ? ", " : "; changed ") << changed[i];
+                if (changed.size() > 8) std::cout << " and " << changed.size() - 8 << " more";
+            }
+            std::cout << std::endl << "Watching " << input << " for changes" << std::endl;
+        }
+
+        // Block for the next event about the input, then let the save settle
+        pollfd waiting = {fd, POLLIN, 0};
+        bool touched = false;
+        while (!touched) {
+            if (::poll(&waiting, 1, -1) < 0 && errno != EINTR) {
+                std::cerr << "Could not watch " << directory << ": " << std::strerror(errno) << std::endl;
+                ::close(fd);
+                return 1;
+            }
+            touched = drainEvents(fd, name);
+        }
+        while (::poll(&waiting, 1, SETTLE_MS) > 0) drainEvents(fd, name);
+    }
+}
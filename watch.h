@@ -0,0 +1,22 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <functional>
+#include <string>
+#include "splc.h"
+
+/**
+ * @brief Watch mode of the command line: compiles one input, then again every
+ * time it is saved, through a splc::Session so that an edit no definition
+ * reachable from main sees costs only the front end. Other edits regenerate
+ * the code of the whole program; only folding is redone per definition. Changes come from inotify
+ * on the input's directory, which also sees editors that save by writing a new
+ * file and renaming it over the old one.
+ */
+
+// Compiles input now and after every change, handing each result to deliver;
+// returns only if the input's directory cannot be watched
+int watch(const std::string& input, const splc::Options& options,
+          const std::function<void(const splc::Result&)>& deliver);
+
+#endif // WATCH_H